@@ -6,6 +6,7 @@
 #include <memory>
 #include <stdexcept>
 #include <format>
+#include <bit>
 
 #include <boost/container/small_vector.hpp>
 
@@ -18,8 +19,8 @@
 #include <functional>
 #endif
 
-template <typename T, size_t N, typename ...Options>
-inline void trivial_insert(boost::container::small_vector<T, N, Options...> &vec, size_t index, T const &value)
+template <typename T, size_t N>
+inline void trivial_insert(BTreeInlineVector<T, N> &vec, size_t index, std::type_identity_t<T> const &value)
 {
 	if constexpr (std::is_trivially_copyable_v<T>) {
 		vec.push_back(value);
@@ -36,8 +37,8 @@ inline void trivial_insert(boost::container::small_vector<T, N, Options...> &vec
 	}
 }
 
-template <typename T, size_t N, typename... Options>
-inline void trivial_append_range(boost::container::small_vector<T, N, Options...> &dst, size_t dstStart, T const *src, size_t count)
+template <typename T, size_t N>
+inline void trivial_append_range(BTreeInlineVector<T, N> &dst, size_t dstStart, T const *src, size_t count)
 {
 	if constexpr (std::is_trivially_copyable_v<T>)
 	{
@@ -66,8 +67,8 @@ inline void trivial_append_range(boost::container::small_vector<T, N, Options...
 	}
 }
 
-template <typename T, size_t N, typename... Options>
-inline void trivial_erase(boost::container::small_vector<T, N, Options...> &vec, size_t index)
+template <typename T, size_t N>
+inline void trivial_erase(BTreeInlineVector<T, N> &vec, size_t index)
 {
 	if constexpr (!std::is_trivially_copyable_v<T>) {
 		T* data = vec.data();
@@ -84,789 +85,2555 @@ inline void trivial_erase(boost::container::small_vector<T, N, Options...> &vec,
 	}
 }
 
-template<typename Key, typename Value, typename Compare>
-BTree<Key, Value, Compare>::Node::Node(bool leaf)
-	: isLeaf(leaf),
-	nextLeaf(nullptr),
-	prevLeaf(nullptr)
+namespace btree_detail
 {
-	if (leaf)
-	{
-		new (&this->leaf) LeafNode();
-	}
-	else
+	/**
+	 * Counts the keys of a sorted array that are below `key` (or below-or-equal when
+	 * `Inclusive`), i.e. the lower (upper) bound index.
+	 *
+	 * A binary search first narrows the window to `s_LINEAR_KEYS` keys, then whole
+	 * vectors are compared at once and their match masks popcounted. Because the
+	 * array is sorted, the first vector whose mask is not full holds the answer.
+	 */
+	template <typename T, bool Inclusive>
+	inline size_t simd_count_below(const T *keys, size_t n, T key)
 	{
-		new (&this->internal) InternalNode();
+		static constexpr size_t s_LINEAR_KEYS = 2 * BTREE_CACHE_LINE / sizeof(T);
+
+		auto below = [key](T k) { return Inclusive ? !(key < k) : k < key; };
+
+		size_t lo = 0;
+
+		while (n > s_LINEAR_KEYS)
+		{
+			size_t half = n / 2;
+
+			if (below(keys[lo + half]))
+			{
+				lo += half + 1;
+				n -= half + 1;
+			}
+			else
+			{
+				n = half;
+			}
+		}
+
+		const T *base = keys + lo;
+		size_t i = 0;
+
+#if defined(BTREE_SIMD_AVX2)
+		if constexpr (std::is_same_v<T, int32_t> || std::is_same_v<T, uint32_t>)
+		{
+			// unsigned keys are compared as signed after flipping the sign bit
+			const __m256i bias = _mm256_set1_epi32(std::is_same_v<T, uint32_t> ? INT32_MIN : 0);
+			const __m256i needle = _mm256_xor_si256(_mm256_set1_epi32(static_cast<int32_t>(key)), bias);
+
+			for (; i + 8 <= n; i += 8)
+			{
+				__m256i k = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(base + i)), bias);
+				__m256i m = Inclusive
+					? _mm256_xor_si256(_mm256_cmpgt_epi32(k, needle), _mm256_set1_epi32(-1))
+					: _mm256_cmpgt_epi32(needle, k);
+				unsigned mask = static_cast<unsigned>(_mm256_movemask_ps(_mm256_castsi256_ps(m)));
+
+				if (mask != 0xFFu)
+					return lo + i + std::popcount(mask);
+			}
+		}
+		else if constexpr (std::is_same_v<T, int64_t>)
+		{
+			const __m256i needle = _mm256_set1_epi64x(key);
+
+			for (; i + 4 <= n; i += 4)
+			{
+				__m256i k = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(base + i));
+				__m256i m = Inclusive
+					? _mm256_xor_si256(_mm256_cmpgt_epi64(k, needle), _mm256_set1_epi64x(-1))
+					: _mm256_cmpgt_epi64(needle, k);
+				unsigned mask = static_cast<unsigned>(_mm256_movemask_pd(_mm256_castsi256_pd(m)));
+
+				if (mask != 0xFu)
+					return lo + i + std::popcount(mask);
+			}
+		}
+		else if constexpr (std::is_same_v<T, double>)
+		{
+			const __m256d needle = _mm256_set1_pd(key);
+
+			for (; i + 4 <= n; i += 4)
+			{
+				__m256d k = _mm256_loadu_pd(base + i);
+				__m256d m = Inclusive ? _mm256_cmp_pd(k, needle, _CMP_LE_OQ) : _mm256_cmp_pd(k, needle, _CMP_LT_OQ);
+				unsigned mask = static_cast<unsigned>(_mm256_movemask_pd(m));
+
+				if (mask != 0xFu)
+					return lo + i + std::popcount(mask);
+			}
+		}
+#elif defined(BTREE_SIMD_SSE4)
+		if constexpr (std::is_same_v<T, int32_t> || std::is_same_v<T, uint32_t>)
+		{
+			// unsigned keys are compared as signed after flipping the sign bit
+			const __m128i bias = _mm_set1_epi32(std::is_same_v<T, uint32_t> ? INT32_MIN : 0);
+			const __m128i needle = _mm_xor_si128(_mm_set1_epi32(static_cast<int32_t>(key)), bias);
+
+			for (; i + 4 <= n; i += 4)
+			{
+				__m128i k = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(base + i)), bias);
+				__m128i m = Inclusive
+					? _mm_xor_si128(_mm_cmpgt_epi32(k, needle), _mm_set1_epi32(-1))
+					: _mm_cmpgt_epi32(needle, k);
+				unsigned mask = static_cast<unsigned>(_mm_movemask_ps(_mm_castsi128_ps(m)));
+
+				if (mask != 0xFu)
+					return lo + i + std::popcount(mask);
+			}
+		}
+		else if constexpr (std::is_same_v<T, int64_t>)
+		{
+			const __m128i needle = _mm_set1_epi64x(key);
+
+			for (; i + 2 <= n; i += 2)
+			{
+				__m128i k = _mm_loadu_si128(reinterpret_cast<const __m128i *>(base + i));
+				__m128i m = Inclusive
+					? _mm_xor_si128(_mm_cmpgt_epi64(k, needle), _mm_set1_epi64x(-1))
+					: _mm_cmpgt_epi64(needle, k);
+				unsigned mask = static_cast<unsigned>(_mm_movemask_pd(_mm_castsi128_pd(m)));
+
+				if (mask != 0x3u)
+					return lo + i + std::popcount(mask);
+			}
+		}
+		else if constexpr (std::is_same_v<T, double>)
+		{
+			const __m128d needle = _mm_set1_pd(key);
+
+			for (; i + 2 <= n; i += 2)
+			{
+				__m128d k = _mm_loadu_pd(base + i);
+				__m128d m = Inclusive ? _mm_cmple_pd(k, needle) : _mm_cmplt_pd(k, needle);
+				unsigned mask = static_cast<unsigned>(_mm_movemask_pd(m));
+
+				if (mask != 0x3u)
+					return lo + i + std::popcount(mask);
+			}
+		}
+#endif
+
+		// scalar tail (and the whole window when no vector unit is available)
+		while (i < n && below(base[i]))
+		{
+			++i;
+		}
+
+		return lo + i;
 	}
 }
 
-template <typename Key, typename Value, typename Compare>
-BTree<Key, Value, Compare>::Node::~Node()
+template <typename T>
+inline size_t simd_lower_bound(const T *keys, size_t n, T key)
+{
+	return btree_detail::simd_count_below<T, false>(keys, n, key);
+}
+
+template <typename T>
+inline size_t simd_upper_bound(const T *keys, size_t n, T key)
+{
+	return btree_detail::simd_count_below<T, true>(keys, n, key);
+}
+
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::Node::Node(bool leaf)
+	: isLeaf(leaf),
+	handle()
+{
+}
+
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+uint32_t BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::BlockDirectory::acquire(uint8_t* block)
 {
-	if (isLeaf)
+	std::lock_guard lock(mutex);
+	uint32_t number;
+
+	if (!freeNumbers.empty())
 	{
-		this->leaf.~LeafNode();
+		number = freeNumbers.back();
+		freeNumbers.pop_back();
 	}
 	else
 	{
-		this->internal.~InternalNode();
+		if (nextNumber >> (32 - s_NUMBER_SHIFT))
+		{
+			throw std::length_error("BTree node handles exhausted");
+		}
+
+		number = nextNumber++;
+	}
+
+	auto &page = pages[number >> s_PAGE_BITS];
+
+	if (!page)
+	{
+		page = std::make_unique<uint8_t*[]>(size_t(1) << s_PAGE_BITS);
 	}
+
+	page[number & ((1u << s_PAGE_BITS) - 1)] = block;
+
+	return number;
 }
 
-template <typename Key, typename Value, typename Compare>
-void BTree<Key, Value, Compare>::NodePool::addBlock()
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+void BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::BlockDirectory::release(uint32_t number)
 {
-	blocks.emplace_back(std::make_unique<uint8_t[]>(s_BLOCK_BYTES));
-	currentBlock = blocks.back().get();
-	offset = 0;
+	std::lock_guard lock(mutex);
+
+	pages[number >> s_PAGE_BITS][number & ((1u << s_PAGE_BITS) - 1)] = nullptr;
+	freeNumbers.push_back(number);
 }
 
-template <typename Key, typename Value, typename Compare>
-typename BTree<Key, Value, Compare>::Node *
-BTree<Key, Value, Compare>::NodePool::allocate(bool isLeaf)
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::NodePool::Block::Block(std::unique_ptr<uint8_t[]> mem, size_t sizeClass)
+	: memory(std::move(mem)), cls(sizeClass), number()
 {
-	if (offset + sizeof(Node) > s_BLOCK_BYTES)
+	if constexpr (s_COMPACT_HANDLES)
 	{
-		addBlock();
+		number = BlockDirectory::acquire(memory.get());
 	}
+}
+
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::NodePool::Block::Block(Block &&other) noexcept
+	: memory(std::move(other.memory)), cls(other.cls), number(std::exchange(other.number, {}))
+{
+}
 
-	void *mem = static_cast<void *>(currentBlock + offset);
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+typename BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::NodePool::Block&
+BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::NodePool::Block::operator=(Block &&other) noexcept
+{
+	if (this != &other)
+	{
+		if constexpr (s_COMPACT_HANDLES)
+		{
+			if (number)
+			{
+				BlockDirectory::release(number);
+			}
+		}
+
+		memory = std::move(other.memory);
+		cls = other.cls;
+		number = std::exchange(other.number, {});
+	}
 
-	offset += sizeof(Node);
+	return *this;
+}
 
-	return new (mem) Node(isLeaf);
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::NodePool::Block::~Block()
+{
+	if constexpr (s_COMPACT_HANDLES)
+	{
+		if (number)
+		{
+			BlockDirectory::release(number);
+		}
+	}
 }
 
-template <typename Key, typename Value, typename Compare>
-BTree<Key, Value, Compare>::NodePool::NodePool() : currentBlock(nullptr), offset(0)
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+void BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::NodePool::addBlock(size_t cls)
 {
-	addBlock();
+	blocks.emplace_back(std::make_unique<uint8_t[]>(blockBytes(cls)), cls);
+	currentBlock[cls] = blocks.back().get();
+	offset[cls] = 0;
+
+	if constexpr (s_COMPACT_HANDLES)
+	{
+		currentNumber[cls] = blocks.back().number;
+	}
 }
 
-template <typename Key, typename Value, typename Compare>
-typename BTree<Key, Value, Compare>::Node*
-BTree<Key, Value, Compare>::allocateNode(bool isLeaf)
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+void BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::NodePool::closeBumpBlocks()
 {
-	return m_nodePool.allocate(isLeaf);
+	for (size_t cls = 0; cls < s_SIZE_CLASSES; ++cls)
+	{
+		currentBlock[cls] = nullptr;
+		offset[cls] = blockBytes(cls);
+	}
 }
 
-template <typename Key, typename Value, typename Compare>
-void BTree<Key, Value, Compare>::destroyNode(Node* node)
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+typename BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::Node *
+BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::NodePool::allocate(bool isLeaf)
 {
-	if (!node) return;
+	const size_t cls = sizeClass(isLeaf);
+	uint8_t *mem;
+	uint32_t handle = 0;
+
+	if (FreeSlot*& head = freeLists[cls]; head)
+	{
+		mem = reinterpret_cast<uint8_t *>(head);
+
+		if constexpr (s_COMPACT_HANDLES)
+		{
+			handle = head->handle;
+		}
+
+		head = head->next;
+		--freeSlots;
+
+		if (!head)
+		{
+			freeTails[cls] = nullptr;
+		}
+	}
+	else
+	{
+		if (offset[cls] + s_SLOT_BYTES[cls] > blockBytes(cls))
+		{
+			addBlock(cls);
+		}
 
-	if (!node->isLeaf) {
-		for (Node* child : node->internal.children) {
-			destroyNode(child);
+		mem = currentBlock[cls] + offset[cls];
+
+		if constexpr (s_COMPACT_HANDLES)
+		{
+			handle = bumpHandle(cls, offset[cls]);
 		}
+
+		offset[cls] += s_SLOT_BYTES[cls];
+	}
+
+	++liveSlots;
+	liveBytes += s_SLOT_BYTES[cls];
+
+	Node* node = isLeaf
+		? static_cast<Node*>(new (mem) SizedNode<LeafNode>())
+		: static_cast<Node*>(new (mem) SizedNode<InternalNode>());
+
+	if constexpr (s_COMPACT_HANDLES)
+	{
+		node->handle = handle;
 	}
 
-	node->~Node();
+	return node;
 }
 
-template <typename Key, typename Value, typename Compare>
-BTree<Key, Value, Compare>::BTree(const Compare &comp) : m_Comp(std::move(comp)), m_Size(0)
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+void BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::NodePool::release(Node* node)
 {
-	m_Root = allocateNode(true);
-}
+	const size_t cls = sizeClass(node->isLeaf);
+	FreeSlot*& head = freeLists[cls];
+	const auto handle = node->handle;
+	void *slot;
+
+	if (node->isLeaf)
+	{
+		auto *sized = static_cast<SizedNode<LeafNode>*>(node);
+
+		slot = sized;
+		sized->~SizedNode();
+	}
+	else
+	{
+		auto *sized = static_cast<SizedNode<InternalNode>*>(node);
+
+		slot = sized;
+		sized->~SizedNode();
+	}
+
+	--liveSlots;
+	liveBytes -= s_SLOT_BYTES[cls];
+
+	// slots of retiring blocks are never handed out again
+	if (!retiring.empty() && retires(static_cast<const Node*>(slot)))
+	{
+		--retiringLive;
+		return;
+	}
+
+	head = new (slot) FreeSlot{head, handle};
+	++freeSlots;
 
+	if (!head->next)
+	{
+		freeTails[cls] = head;
+	}
+}
 
-template<typename Key, typename Value, typename Compare>
-BTree<Key, Value, Compare>::~BTree()
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+void BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::NodePool::adopt(NodePool &other)
 {
-	destroyNode(m_Root);
+	for (size_t cls = 0; cls < s_SIZE_CLASSES; ++cls)
+	{
+		// the untouched rest of the other bump block becomes free slots, so the counters stay exact
+		for (size_t at = other.offset[cls]; at + s_SLOT_BYTES[cls] <= blockBytes(cls); at += s_SLOT_BYTES[cls])
+		{
+			FreeSlot*& head = other.freeLists[cls];
+
+			head = new (static_cast<void *>(other.currentBlock[cls] + at)) FreeSlot{head, {}};
+
+			if constexpr (s_COMPACT_HANDLES)
+			{
+				head->handle = other.bumpHandle(cls, at);
+			}
+
+			++other.freeSlots;
+
+			if (!head->next)
+			{
+				other.freeTails[cls] = head;
+			}
+		}
+
+		if (!other.freeLists[cls])
+		{
+			continue;
+		}
+
+		other.freeTails[cls]->next = freeLists[cls];
+
+		if (!freeLists[cls])
+		{
+			freeTails[cls] = other.freeTails[cls];
+		}
+
+		freeLists[cls] = other.freeLists[cls];
+		other.freeLists[cls] = nullptr;
+		other.freeTails[cls] = nullptr;
+	}
+
+	other.closeBumpBlocks();
+
+	// keep bump-allocating from our own blocks
+	blocks.insert(blocks.end(),
+		std::make_move_iterator(other.blocks.begin()),
+		std::make_move_iterator(other.blocks.end()));
+	other.blocks.clear();
+
+	liveSlots += other.liveSlots;
+	liveBytes += other.liveBytes;
+	freeSlots += other.freeSlots;
+	other.liveSlots = 0;
+	other.liveBytes = 0;
+	other.freeSlots = 0;
 }
 
-template <typename Key, typename Value, typename Compare>
-Value& BTree<Key, Value, Compare>::operator[](const Key &key)
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+void BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::NodePool::beginRetire()
 {
-	if (Value* p = search(key)) {
-		return *p;
+	retiring.clear();
+
+	for (auto const &block : blocks)
+	{
+		retiring.emplace_back(block.get(), block.get() + blockBytes(block.cls));
 	}
 
-	throw std::out_of_range(std::format("BTree[] lookup failed: key {} not found", key));
+	std::sort(retiring.begin(), retiring.end(), [](auto const &a, auto const &b) {
+		return std::less<const uint8_t*>{}(a.first, b.first);
+	});
+
+	for (size_t cls = 0; cls < s_SIZE_CLASSES; ++cls)
+	{
+		freeLists[cls] = nullptr;
+		freeTails[cls] = nullptr;
+	}
+
+	freeSlots = 0;
+	retiringLive = liveSlots;
+
+	closeBumpBlocks();
 }
 
-template <typename Key, typename Value, typename Compare>
-size_t BTree<Key, Value, Compare>::size() const
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+bool BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::NodePool::retires(const Node* node) const
 {
-	return m_Size;
+	const uint8_t* addr = reinterpret_cast<const uint8_t*>(node);
+	auto it = std::upper_bound(retiring.begin(), retiring.end(), addr, [](const uint8_t* a, auto const &range) {
+		return std::less<const uint8_t*>{}(a, range.first);
+	});
+
+	return it != retiring.begin() && std::less<const uint8_t*>{}(addr, (it - 1)->second);
 }
 
-template <typename Key, typename Value, typename Compare>
-void BTree<Key, Value, Compare>::splitChild(Node* parent, size_t index)
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+void BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::NodePool::finishRetire()
 {
-	Node* child = parent->internal.children[index];
-	Node *sibling = allocateNode(child->isLeaf);
+	std::erase_if(blocks, [this](auto const &block) {
+		auto it = std::lower_bound(retiring.begin(), retiring.end(), block.get(), [](auto const &range, const uint8_t* a) {
+			return std::less<const uint8_t*>{}(range.first, a);
+		});
 
-	if (child->isLeaf) {
-		auto midIt = child->leaf.entries.begin() + BTree::s_CAPACITY;
+		return it != retiring.end() && it->first == block.get();
+	});
 
-		sibling->leaf.entries.insert(
-			sibling->leaf.entries.end(),
-			std::make_move_iterator(midIt),
-			std::make_move_iterator(child->leaf.entries.end())
-		);
+	retiring.clear();
+}
 
-		child->leaf.entries.erase(midIt, child->leaf.entries.end());
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::NodePool::NodePool()
+{
+	closeBumpBlocks();
+}
 
-		sibling->nextLeaf = child->nextLeaf;
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+typename BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::Node*
+BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::allocateNode(bool isLeaf)
+{
+	return m_nodePool->allocate(isLeaf);
+}
 
-		if (child->nextLeaf) {
-			child->nextLeaf->prevLeaf = sibling;
-		}
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+void BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::releaseNode(Node* node)
+{
+	m_nodePool->release(node);
+}
 
-		child->nextLeaf = sibling;
-		sibling->prevLeaf = child;
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+size_t BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::destroyNode(Node* node)
+{
+	if (!node) return 0;
 
-		Key promoteKey = sibling->leaf.entries.front().first;
+	size_t entries = 0;
 
-		trivial_insert(parent->internal.keys, index, promoteKey);
-		trivial_insert(parent->internal.children, index + 1, sibling);
+	if (node->isLeaf) {
+		entries = node->leaf().size();
 	} else {
-		size_t mid = BTree::s_CAPACITY - 1;
-		Key medianKey = std::move(child->internal.keys[mid]);
-
-		if (sibling->internal.keys.size() - mid - 1 > 0)
-		{
-			trivial_append_range(sibling->internal.keys,
-				sibling->internal.keys.size(),
-				child->internal.keys.data() + mid + 1,
-				child->internal.keys.size() - mid - 1
-			);
+		for (Node* child : node->internal().children) {
+			entries += destroyNode(child);
 		}
+	}
 
-		if (sibling->internal.children.size() - mid - 1 > 0)
-		{
-			trivial_append_range(sibling->internal.children,
-				sibling->internal.children.size(),
-				child->internal.children.data() + mid + 1,
-				child->internal.children.size() - mid - 1
-			);
-		}
+	releaseNode(node);
+
+	return entries;
+}
 
-		child->internal.keys.erase(child->internal.keys.begin() + mid, child->internal.keys.end());
-		child->internal.children.erase(child->internal.children.begin() + mid + 1, child->internal.children.end());
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+typename BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::PoolStats
+BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::poolStats() const
+{
+	const size_t blockCount = m_nodePool->blocks.size();
+	const size_t capacity = blockCount * s_BLOCK_NODES;
+	size_t unused = 0;
 
-		trivial_insert(parent->internal.keys, index, std::move(medianKey));
-		trivial_insert(parent->internal.children, index + 1, sibling);
+	for (size_t cls = 0; cls < s_SIZE_CLASSES; ++cls)
+	{
+		unused += (blockBytes(cls) - m_nodePool->offset[cls]) / s_SLOT_BYTES[cls];
 	}
+
+	return PoolStats{
+		m_nodePool->liveSlots,
+		m_nodePool->freeSlots,
+		capacity - unused,
+		capacity,
+		blockCount,
+		m_nodePool->liveBytes
+	};
 }
 
-template <typename Key, typename Value, typename Compare>
-bool BTree<Key, Value, Compare>::insertNonFull(Node* node, const Key& key, const Value& value)
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+size_t BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::height() const
 {
-	if (node->isLeaf) {
-		auto it = std::lower_bound(
-			node->leaf.entries.begin(),
-			node->leaf.entries.end(),
-			key,
-			[this](auto const &entry, auto const &v) { return less(entry.first, v); }
-		);
+	size_t levels = 0;
+
+	for (Node* node = m_Root; !node->isLeaf; node = node->internal().children.front())
+	{
+		++levels;
+	}
 
-		if (it != node->leaf.entries.end() && !less(key, it->first) && !less(it->first, key))
+	return levels;
+}
+
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+typename BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::Node*
+BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::relocateNode(Node* node, const std::vector<PathEntry> &path)
+{
+	Node* fresh = allocateNode(node->isLeaf);
+
+	if (node->isLeaf)
+	{
+		fresh->leaf() = std::move(node->leaf());
+		fresh->leaf().prevLeaf = node->leaf().prevLeaf;
+		fresh->leaf().nextLeaf = node->leaf().nextLeaf;
+
+		if (m_LastLeaf == node)
 		{
-			it->second = value;
+			m_LastLeaf = fresh;
+		}
 
-			return false;
+		if (fresh->leaf().prevLeaf)
+		{
+			fresh->leaf().prevLeaf->leaf().nextLeaf = fresh;
 		}
 
-		node->leaf.entries.emplace(it, key, value);
+		if (fresh->leaf().nextLeaf)
+		{
+			fresh->leaf().nextLeaf->leaf().prevLeaf = fresh;
+		}
+	}
+	else
+	{
+		fresh->internal() = std::move(node->internal());
+	}
 
-		return true;
+	if (path.empty())
+	{
+		m_Root = fresh;
+	}
+	else
+	{
+		path.back().node->internal().children[path.back().childIdx] = fresh;
 	}
 
-	size_t i = 0;
+	releaseNode(node);
+
+	return fresh;
+}
+
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+bool BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::compact(size_t maxNodes)
+{
+	// the shared blocks cannot be emptied, copy the tree into blocks of its own instead
+	if (!m_Compact.active && m_nodePool.use_count() > 1)
+	{
+		std::shared_ptr<NodePool> shared = std::exchange(m_nodePool, std::make_shared<NodePool>());
+		Node* prevLeaf = nullptr;
+
+		m_Root = adoptSubtree(m_Root, *shared, prevLeaf);
+		m_LastLeaf = prevLeaf;
+
+		return true;
+	}
 
-	while (i < node->internal.keys.size() && less(node->internal.keys[i], key))
+	if (!m_Compact.active)
 	{
-		++i;
+		m_nodePool->beginRetire();
+		m_Compact = CompactCursor{true, 0, height(), std::nullopt};
 	}
 
-	Node *child = node->internal.children[i];
+	size_t budget = maxNodes ? maxNodes : SIZE_MAX;
+	std::vector<PathEntry> path;
+
+	while (budget && m_nodePool->retiringLive)
+	{
+		// the levels shifted under the cursor: start over from the root
+		if (size_t levels = height(); levels != m_Compact.height)
+		{
+			m_Compact.height = levels;
+			m_Compact.depth = 0;
+			m_Compact.resume.reset();
+		}
+
+		path.clear();
+
+		Node* node = m_Root;
+
+		while (path.size() < m_Compact.depth)
+		{
+			size_t idx = m_Compact.resume ? childIndex(node, *m_Compact.resume) : 0;
+
+			path.push_back({node, idx, nullptr});
+			node = node->internal().children[idx];
+		}
+
+		while (budget)
+		{
+			if (m_nodePool->retires(node))
+			{
+				node = relocateNode(node, path);
+			}
+
+			--budget;
+
+			size_t up = path.size();
 
-	bool childFull = child->isLeaf ? (child->leaf.entries.size() >= BTree::s_MAX_KEYS) : (child->internal.keys.size() >= BTree::s_MAX_KEYS);
+			while (up && path[up - 1].childIdx + 1 == path[up - 1].node->internal().children.size())
+			{
+				--up;
+			}
+
+			if (!up)
+			{
+				// level done; after the leaves wrap around for whatever was missed
+				m_Compact.depth = m_Compact.depth < m_Compact.height ? m_Compact.depth + 1 : 0;
+				m_Compact.resume.reset();
+				break;
+			}
+
+			path.resize(up);
+
+			PathEntry &entry = path.back();
+
+			m_Compact.resume = separatorKey(entry.node->internal().keys[entry.childIdx]);
+			node = entry.node->internal().children[++entry.childIdx];
+
+			while (path.size() < m_Compact.depth)
+			{
+				path.push_back({node, 0, nullptr});
+				node = node->internal().children.front();
+			}
+		}
+	}
+
+	if (m_nodePool->retiringLive)
+	{
+		return false;
+	}
+
+	m_nodePool->finishRetire();
+	m_Compact = CompactCursor{};
+
+	return true;
+}
+
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::BTree(const Compare &comp) : m_Comp(std::move(comp)), m_Size(0)
+{
+	m_Root = allocateNode(true);
+	m_LastLeaf = m_Root;
+}
+
+
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+template <typename InputIt>
+BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::BTree(InputIt first, InputIt last, double fillFactor, const Compare &comp)
+	: BTree(comp)
+{
+	bulkLoad(first, last, fillFactor);
+}
+
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::BTree(const Compare &comp, std::shared_ptr<NodePool> pool, Node* root, size_t size)
+	: m_Comp(comp), m_Size(size), m_nodePool(std::move(pool))
+{
+	m_Root = root ? root : allocateNode(true);
+	m_LastLeaf = lastLeaf(m_Root);
+}
+
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::BTree(BTree &&other)
+	: m_Root(other.m_Root),
+	m_LastLeaf(other.m_LastLeaf),
+	m_Comp(other.m_Comp),
+	m_Size(other.m_Size),
+	m_nodePool(std::move(other.m_nodePool)),
+	m_Compact(std::move(other.m_Compact))
+{
+	other.m_nodePool = std::make_shared<NodePool>();
+	other.m_Root = other.allocateNode(true);
+	other.m_LastLeaf = other.m_Root;
+	other.m_Size = 0;
+	other.m_Compact = CompactCursor{};
+}
+
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>&
+BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::operator=(BTree &&other)
+{
+	if (this != &other)
+	{
+		destroyNode(m_Root);
+
+		m_Root = std::exchange(other.m_Root, nullptr);
+		m_LastLeaf = other.m_LastLeaf;
+		m_Comp = other.m_Comp;
+		m_Size = std::exchange(other.m_Size, 0);
+		m_nodePool = std::exchange(other.m_nodePool, std::make_shared<NodePool>());
+		m_Compact = std::exchange(other.m_Compact, CompactCursor{});
+
+		other.m_Root = other.allocateNode(true);
+		other.m_LastLeaf = other.m_Root;
+	}
+
+	return *this;
+}
+
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::~BTree()
+{
+	destroyNode(m_Root);
+}
+
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+Value& BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::operator[](const Key &key)
+{
+	if (Value* p = search(key)) {
+		return *p;
+	}
+
+	throw std::out_of_range(std::format("BTree[] lookup failed: key {} not found", key));
+}
+
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+size_t BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::size() const
+{
+	return m_Size;
+}
+
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+void BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::splitChild(Node* parent, size_t index)
+{
+	Node* child = parent->internal().children[index];
+	Node *sibling = allocateNode(child->isLeaf);
+
+	if (child->isLeaf) {
+		child->leaf().moveTail(child->leaf().size() / 2, sibling->leaf());
+
+		sibling->leaf().nextLeaf = child->leaf().nextLeaf;
+
+		if (child->leaf().nextLeaf) {
+			child->leaf().nextLeaf->leaf().prevLeaf = sibling;
+		}
+
+		child->leaf().nextLeaf = sibling;
+		sibling->leaf().prevLeaf = child;
+
+		if (m_LastLeaf == child) {
+			m_LastLeaf = sibling;
+		}
+
+		Key promoteKey = separatorBetween(child->leaf().key(child->leaf().size() - 1), sibling->leaf().key(0));
+
+		trivial_insert(parent->internal().keys, index, promoteKey);
+		trivial_insert(parent->internal().children, index + 1, sibling);
+	} else {
+		size_t mid = child->internal().keys.size() / 2;
+		SeparatorKey medianKey = std::move(child->internal().keys[mid]);
+
+		if (child->internal().keys.size() - mid - 1 > 0)
+		{
+			trivial_append_range(sibling->internal().keys,
+				sibling->internal().keys.size(),
+				child->internal().keys.data() + mid + 1,
+				child->internal().keys.size() - mid - 1
+			);
+		}
+
+		if (child->internal().children.size() - mid - 1 > 0)
+		{
+			trivial_append_range(sibling->internal().children,
+				sibling->internal().children.size(),
+				child->internal().children.data() + mid + 1,
+				child->internal().children.size() - mid - 1
+			);
+		}
+
+		child->internal().keys.erase(child->internal().keys.begin() + mid, child->internal().keys.end());
+		child->internal().children.erase(child->internal().children.begin() + mid + 1, child->internal().children.end());
+
+		trivial_insert(parent->internal().keys, index, std::move(medianKey));
+		trivial_insert(parent->internal().children, index + 1, sibling);
+	}
+
+	refreshChild(parent, index);
+	refreshChild(parent, index + 1);
+}
+
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+bool BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::insertNonFull(Node* node, const Key& key, const Value& value)
+{
+	if (node->isLeaf) {
+		size_t idx = leafLowerBound(node, key);
+
+		if (leafHolds(node, idx, key))
+		{
+			node->leaf().value(idx) = value;
+
+			return false;
+		}
+
+		node->leaf().insert(idx, key, value);
+
+		return true;
+	}
+
+	size_t i = childIndex(node, key);
+	Node *child = node->internal().children[i];
+
+	if (isFull(child)) {
+		splitChild(node, i);
+
+		if (!less(key, separatorKey(node->internal().keys[i])))
+		{
+			++i;
+		}
+	}
+
+	bool inserted = insertNonFull(node->internal().children[i], key, value);
+
+	// an overwritten value still changes the aggregates
+	if (inserted || s_AGGREGATE) {
+		refreshChild(node, i);
+	}
+
+	return inserted;
+}
+
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+bool BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::insert(const Key& key, const Value& value)
+{
+	if (isAppend(key)) {
+		appendLast(key, value);
+		++m_Size;
+
+		return true;
+	}
+
+	if (isFull(m_Root)) {
+		Node* oldRoot = m_Root;
+		Node* newRoot = allocateNode(false);
+
+		newRoot->internal().children.push_back(oldRoot);
+		splitChild(newRoot, 0);
+		m_Root = newRoot;
+	}
+
+	bool inserted = insertNonFull(m_Root, key, value);
+
+	if (inserted) {
+		++m_Size;
+	}
+
+	return inserted;
+}
+
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+bool BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::isAppend(const Key& key) const
+{
+	const LeafNode &last = m_LastLeaf->leaf();
+
+	return last.empty() || less(last.key(last.size() - 1), key);
+}
+
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+void BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::appendLast(const Key& key, const Value& value)
+{
+	Node* last = m_LastLeaf;
+
+	if (last->leaf().size() < s_LEAF_MAX_KEYS) {
+		last->leaf().insert(last->leaf().size(), key, value);
+		refreshRightSpine();
+
+		return;
+	}
+
+	Node* leaf = allocateNode(true);
+
+	leaf->leaf().insert(0, key, value);
+	last->leaf().nextLeaf = leaf;
+	leaf->leaf().prevLeaf = last;
+	m_LastLeaf = leaf;
+
+	std::vector<Node*> spine;
+
+	for (Node* node = m_Root; !node->isLeaf; node = node->internal().children.back()) {
+		spine.push_back(node);
+	}
+
+	Key separator = separatorBetween(last->leaf().key(last->leaf().size() - 1), key);
+	Node* child = leaf;
+
+	while (!spine.empty()) {
+		Node* parent = spine.back();
+
+		spine.pop_back();
+
+		if (parent->internal().keys.size() < s_INTERNAL_MAX_KEYS) {
+			parent->internal().keys.push_back(std::move(separator));
+			parent->internal().children.push_back(child);
+			refreshRightSpine();
+
+			return;
+		}
+
+		// right-biased split: the new node takes the last child and the new one and
+		// stays below the minimum until more appends fill it or a removal rebalances it
+		Node* sibling = allocateNode(false);
+
+		sibling->internal().children.push_back(parent->internal().children.back());
+		sibling->internal().children.push_back(child);
+		sibling->internal().keys.push_back(std::move(separator));
+
+		parent->internal().children.pop_back();
+		separator = takeSeparatorKey(parent->internal().keys.back());
+		parent->internal().keys.pop_back();
+
+		child = sibling;
+	}
+
+	Node* newRoot = allocateNode(false);
+
+	newRoot->internal().children.push_back(m_Root);
+	newRoot->internal().children.push_back(child);
+	newRoot->internal().keys.push_back(std::move(separator));
+	m_Root = newRoot;
+	refreshRightSpine();
+}
+
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+void BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::refreshRightSpine()
+{
+	if constexpr (s_AUGMENTED) {
+		boost::container::small_vector<Node*, 16> spine;
+
+		for (Node* node = m_Root; !node->isLeaf; node = node->internal().children.back()) {
+			spine.push_back(node);
+		}
+
+		for (size_t level = spine.size(); level > 0; --level) {
+			Node* node = spine[level - 1];
+			size_t last = node->internal().children.size() - 1;
+
+			// a right-biased split also took a child away from the one before
+			if (last > 0) {
+				refreshChild(node, last - 1);
+			}
+
+			refreshChild(node, last);
+		}
+	}
+}
+
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+std::vector<size_t> BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::batchOrder(std::span<const std::pair<Key, Value>> batch) const
+{
+	std::vector<size_t> order(batch.size());
+
+	if constexpr (std::is_integral_v<Key> && !std::is_same_v<Key, bool> &&
+		(std::is_same_v<Compare, std::less<Key>> || std::is_same_v<Compare, std::less<>>))
+	{
+		// LSD radix sort on the key bytes; signed keys get their sign bit flipped
+		// so that they order correctly as unsigned
+		using UKey = std::make_unsigned_t<Key>;
+		constexpr UKey flip = std::is_signed_v<Key> ? UKey(UKey(1) << (sizeof(Key) * 8 - 1)) : UKey(0);
+
+		std::vector<std::pair<UKey, size_t>> cur(batch.size());
+		std::vector<std::pair<UKey, size_t>> tmp(batch.size());
+
+		for (size_t i = 0; i < batch.size(); ++i) {
+			cur[i] = { static_cast<UKey>(static_cast<UKey>(batch[i].first) ^ flip), i };
+		}
+
+		for (size_t shift = 0; shift < sizeof(Key) * 8; shift += 8) {
+			size_t offsets[257] = {};
+
+			for (auto const &entry : cur) {
+				++offsets[((entry.first >> shift) & 0xFF) + 1];
+			}
+
+			// every key has the same byte here, the pass would not move anything
+			if (std::find(std::begin(offsets), std::end(offsets), batch.size()) != std::end(offsets))
+				continue;
+
+			for (size_t d = 1; d < 257; ++d) {
+				offsets[d] += offsets[d - 1];
+			}
+
+			for (auto const &entry : cur) {
+				tmp[offsets[(entry.first >> shift) & 0xFF]++] = entry;
+			}
+
+			cur.swap(tmp);
+		}
+
+		for (size_t i = 0; i < batch.size(); ++i) {
+			order[i] = cur[i].second;
+		}
+	}
+	else
+	{
+		for (size_t i = 0; i < order.size(); ++i) {
+			order[i] = i;
+		}
+
+		std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+			return less(batch[a].first, batch[b].first);
+		});
+	}
+
+	return order;
+}
+
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+size_t BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::mergeRunIntoLeaf(Node* leaf,
+	std::span<const std::pair<Key, Value>> batch, const std::vector<size_t> &order, size_t begin, size_t end,
+	std::vector<std::pair<Key, Node*>> &siblings)
+{
+	LeafNode &entries = leaf->leaf();
+	size_t firstNew = leafLowerBound(leaf, batch[order[begin]].first);
+	size_t newKeys = 0;
+
+	// a pair is shadowed when the batch holds the same key again later on
+	auto shadowed = [&](size_t r) {
+		return r + 1 < end && !less(batch[order[r]].first, batch[order[r + 1]].first);
+	};
+
+	// 1) Overwrite the keys the leaf already has and count the new ones
+	for (size_t r = begin, li = firstNew; r < end; ++r) {
+		if (shadowed(r))
+			continue;
+
+		const auto &[key, value] = batch[order[r]];
+
+		while (li < entries.size() && less(entries.key(li), key)) {
+			++li;
+		}
+
+		if (li < entries.size() && !less(key, entries.key(li))) {
+			entries.value(li++) = value;
+		} else {
+			++newKeys;
+		}
+	}
+
+	if (newKeys == 0)
+		return 0;
+
+	// 2) Spread the merged entries evenly over as many leaves as needed
+	const size_t total = entries.size() + newKeys;
+	const size_t pieces = (total + BTree::s_LEAF_MAX_KEYS - 1) / BTree::s_LEAF_MAX_KEYS;
+	auto pieceSize = [&](size_t piece) { return total / pieces + (piece < total % pieces ? 1 : 0); };
+
+	LeafNode tail;
+	Node* out = leaf;
+	size_t piece = 0;
+
+	entries.moveTail(std::min(firstNew, pieceSize(0)), tail);
+
+	auto emit = [&](auto &&key, auto &&value) {
+		if (out->leaf().size() == pieceSize(piece)) {
+			Node* next = allocateNode(true);
+
+			siblings.emplace_back(separatorBetween(out->leaf().key(out->leaf().size() - 1), key), next);
+
+			next->leaf().nextLeaf = out->leaf().nextLeaf;
+
+			if (out->leaf().nextLeaf) {
+				out->leaf().nextLeaf->leaf().prevLeaf = next;
+			}
+
+			out->leaf().nextLeaf = next;
+			next->leaf().prevLeaf = out;
+
+			if (m_LastLeaf == out) {
+				m_LastLeaf = next;
+			}
+
+			out = next;
+			++piece;
+		}
+
+		out->leaf().insert(out->leaf().size(), std::forward<decltype(key)>(key), std::forward<decltype(value)>(value));
+	};
+
+	// 3) Merge the moved tail with the new keys
+	size_t ti = 0;
+	size_t r = begin;
+
+	while (ti < tail.size() || r < end) {
+		if (r < end) {
+			const auto &[key, value] = batch[order[r]];
+
+			if (shadowed(r) || (ti < tail.size() && !less(key, tail.key(ti)) && !less(tail.key(ti), key))) {
+				++r;
+
+				continue;
+			}
+
+			if (ti == tail.size() || less(key, tail.key(ti))) {
+				emit(key, value);
+				++r;
+
+				continue;
+			}
+		}
+
+		emit(std::move(tail.key(ti)), std::move(tail.value(ti)));
+		++ti;
+	}
+
+	return newKeys;
+}
+
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+void BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::insertSiblings(std::vector<PathEntry> &path,
+	std::vector<std::pair<Key, Node*>> &&siblings)
+{
+	while (!siblings.empty()) {
+		if (path.empty()) {
+			Node* newRoot = allocateNode(false);
+
+			newRoot->internal().children.push_back(m_Root);
+			m_Root = newRoot;
+			path.push_back({ newRoot, 0, nullptr });
+		}
+
+		Node* parent = path.back().node;
+		size_t idx = path.back().childIdx;
+		auto &keys = parent->internal().keys;
+		auto &children = parent->internal().children;
+
+		path.pop_back();
+
+		std::vector<SeparatorKey> allKeys;
+		std::vector<Node*> allChildren;
+
+		allKeys.reserve(keys.size() + siblings.size());
+		allChildren.reserve(children.size() + siblings.size());
+
+		allKeys.insert(allKeys.end(), std::make_move_iterator(keys.begin()), std::make_move_iterator(keys.begin() + idx));
+		allChildren.insert(allChildren.end(), children.begin(), children.begin() + idx + 1);
+
+		for (auto &[separator, child] : siblings) {
+			allKeys.push_back(std::move(separator));
+			allChildren.push_back(child);
+		}
+
+		allKeys.insert(allKeys.end(), std::make_move_iterator(keys.begin() + idx), std::make_move_iterator(keys.end()));
+		allChildren.insert(allChildren.end(), children.begin() + idx + 1, children.end());
+
+		keys.clear();
+		children.clear();
+
+		// allKeys[i] separates allChildren[i] from allChildren[i + 1]
+		const size_t total = allChildren.size();
+		const size_t pieces = (total + BTree::s_MAX_CHILDREN - 1) / BTree::s_MAX_CHILDREN;
+		std::vector<std::pair<Key, Node*>> promoted;
+		size_t pos = 0;
+
+		for (size_t piece = 0; piece < pieces; ++piece) {
+			size_t size = total / pieces + (piece < total % pieces ? 1 : 0);
+			Node* target = piece == 0 ? parent : allocateNode(false);
+
+			if (piece > 0) {
+				promoted.emplace_back(takeSeparatorKey(allKeys[pos - 1]), target);
+			}
+
+			for (size_t c = 0; c < size; ++c) {
+				if (c > 0) {
+					target->internal().keys.push_back(std::move(allKeys[pos + c - 1]));
+				}
+
+				target->internal().children.push_back(allChildren[pos + c]);
+			}
+
+			refreshChildren(target);
+			pos += size;
+		}
+
+		siblings = std::move(promoted);
+	}
+}
+
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+size_t BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::insertBatch(std::span<const std::pair<Key, Value>> batch)
+{
+	if (batch.empty())
+		return 0;
+
+	std::vector<size_t> order = batchOrder(batch);
+	std::vector<PathEntry> path;
+	size_t inserted = 0;
+	size_t i = 0;
+
+	while (i < order.size()) {
+		const Key &first = batch[order[i]].first;
+
+		// 1) Climb only as far as the next key requires, then descend to its leaf
+		while (!path.empty() && path.back().high && !less(first, *path.back().high)) {
+			path.pop_back();
+		}
+
+		Node* node = m_Root;
+		const Key* high = nullptr;
+
+		if (!path.empty()) {
+			node = path.back().node;
+			high = path.back().high;
+			path.pop_back();
+		}
+
+		while (!node->isLeaf) {
+			size_t c = childIndex(node, first);
+
+			path.push_back({ node, c, high });
+
+			if (c < node->internal().keys.size()) {
+				high = &separatorKey(node->internal().keys[c]);
+			}
+
+			node = node->internal().children[c];
+		}
+
+		// 2) Every following key below the leaf's upper bound belongs to it as well
+		size_t end = i + 1;
+
+		while (end < order.size() && (!high || less(batch[order[end]].first, *high))) {
+			++end;
+		}
+
+		std::vector<std::pair<Key, Node*>> siblings;
+
+		inserted += mergeRunIntoLeaf(node, batch, order, i, end, siblings);
+		i = end;
+
+		// 3) New leaves change the separators the path points into, so start over from the root
+		if (!siblings.empty()) {
+			insertSiblings(path, std::move(siblings));
+			refreshPath(path);
+			path.clear();
+		} else {
+			refreshPath(path);
+		}
+	}
+
+	m_Size += inserted;
+
+	return inserted;
+}
+
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+Value* BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::search(const Key& key) const
+{
+	Node* node = findLeaf(key);
+	size_t idx = leafLowerBound(node, key);
+
+	if (leafHolds(node, idx, key)) {
+		return &node->leaf().value(idx);
+	}
+
+	return nullptr;
+}
+
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+void BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::searchBatch(std::span<const Key> keys, std::span<Value*> out) const
+{
+	Node* cursors[s_BATCH_GROUP];
+
+	for (size_t start = 0; start < keys.size(); start += s_BATCH_GROUP) {
+		const size_t count = std::min(s_BATCH_GROUP, keys.size() - start);
+		const Key* group = keys.data() + start;
+
+		for (size_t j = 0; j < count; ++j) {
+			cursors[j] = m_Root;
+		}
+
+		// every leaf sits at the same depth, so the whole group reaches the leaves together
+		while (!cursors[0]->isLeaf) {
+			for (size_t j = 0; j < count; ++j) {
+				Node* next = cursors[j]->internal().children[childIndex(cursors[j], group[j])];
+
+				prefetchNode(next);
+				cursors[j] = next;
+			}
+		}
+
+		for (size_t j = 0; j < count; ++j) {
+			Node* leaf = cursors[j];
+			size_t idx = leafLowerBound(leaf, group[j]);
+
+			out[start + j] = leafHolds(leaf, idx, group[j])
+				? &leaf->leaf().value(idx)
+				: nullptr;
+		}
+	}
+}
+
+
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+bool BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::remove(const Key& key)
+{
+	boost::container::small_vector<PathEntry, 16> path;
+	Node* node = m_Root;
+
+	while (!node->isLeaf) {
+		size_t idx = childIndex(node, key);
+
+		path.push_back({node, idx, nullptr});
+		node = node->internal().children[idx];
+	}
+
+	size_t idx = leafLowerBound(node, key);
+
+	if (!leafHolds(node, idx, key)) {
+		return false;
+	}
+
+	node->leaf().erase(idx);
+	--m_Size;
+
+	// fix up bottom-up, only as far as the nodes keep underflowing (summaries go all the way up);
+	// nodes left underfull by appends are only refilled here, once a removal reaches them
+	for (size_t level = path.size(); level > 0; --level) {
+		const PathEntry &entry = path[level - 1];
+
+		if (underflows(node)) {
+			if (node->isLeaf) {
+				rebalanceLeaf(node, entry.node, entry.childIdx);
+			} else {
+				rebalanceInternal(node, entry.node, entry.childIdx);
+			}
+		} else if constexpr (s_AUGMENTED) {
+			refreshChild(entry.node, entry.childIdx);
+		} else {
+			break;
+		}
+
+		node = entry.node;
+	}
+
+	collapseRoot();
+
+	return true;
+}
+
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+void BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::collapseRoot()
+{
+	// an internal root left with a single child hands the root over to it
+	while (!m_Root->isLeaf && m_Root->internal().keys.empty()) {
+		Node *old = m_Root;
+
+		m_Root = m_Root->internal().children.front();
+
+		releaseNode(old);
+	}
+}
+
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+std::pair<typename BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::Subtree, typename BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::Subtree>
+BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::splitSubtree(Subtree tree, const Key &key, bool inclusive)
+{
+	// the pieces of each internal level left and right of the descent path, top level first
+	boost::container::small_vector<Subtree, 16> lefts;
+	boost::container::small_vector<Subtree, 16> rights;
+	Node* node = tree.root;
+	size_t height = tree.height;
+
+	while (!node->isLeaf) {
+		InternalNode &in = node->internal();
+		size_t idx = childIndex(node, key);
+		size_t after = in.children.size() - idx - 1;
+		Node* next = in.children[idx];
+		Subtree left{ nullptr, height - 1 };
+		Subtree right{ nullptr, height - 1 };
+
+		// a piece of one child is that child's subtree, wider pieces keep a node
+		if (after == 1) {
+			right.root = in.children[idx + 1];
+		} else if (after > 1) {
+			Node* sibling = allocateNode(false);
+
+			sibling->internal().keys.assign(std::make_move_iterator(in.keys.begin() + idx + 1), std::make_move_iterator(in.keys.end()));
+			sibling->internal().children.assign(in.children.begin() + idx + 1, in.children.end());
+			right = { sibling, height };
+		}
+
+		if (idx == 1) {
+			left.root = in.children[0];
+		} else if (idx > 1) {
+			in.keys.erase(in.keys.begin() + idx - 1, in.keys.end());
+			in.children.erase(in.children.begin() + idx, in.children.end());
+			left = { node, height };
+		}
+
+		if (idx < 2) {
+			releaseNode(node);
+		}
+
+		lefts.push_back(left);
+		rights.push_back(right);
+		node = next;
+		--height;
+	}
+
+	LeafNode &leaf = node->leaf();
+	size_t pos = leafLowerBound(node, key);
+
+	if (inclusive && leafHolds(node, pos, key)) {
+		++pos;
+	}
+
+	Node* prev = node->leaf().prevLeaf;
+	Node* next = node->leaf().nextLeaf;
+	Node* tail = nullptr;
+
+	if (pos == 0) {
+		tail = node;
+	} else if (pos < leaf.size()) {
+		tail = allocateNode(true);
+		leaf.moveTail(pos, tail->leaf());
+		tail->leaf().nextLeaf = next;
+
+		if (next) {
+			next->leaf().prevLeaf = tail;
+		}
+	}
+
+	// cut the leaf chain between the two parts
+	Node* lastBefore = pos > 0 ? node : prev;
+	Node* firstFrom = tail ? tail : next;
+
+	if (lastBefore) {
+		lastBefore->leaf().nextLeaf = nullptr;
+	}
+
+	if (firstFrom) {
+		firstFrom->leaf().prevLeaf = nullptr;
+	}
+
+	Subtree before{ pos > 0 ? node : nullptr, 0 };
+	Subtree from{ tail, 0 };
+
+	if (tail == node && leaf.empty()) {
+		releaseNode(node);
+		from.root = nullptr;
+	}
+
+	// glue the pieces back together bottom-up; heights grow by at most one per level
+	for (size_t level = lefts.size(); level > 0; --level) {
+		before = joinSubtrees(lefts[level - 1], before);
+		from = joinSubtrees(from, rights[level - 1]);
+	}
+
+	return { before, from };
+}
+
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+typename BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::Subtree
+BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::joinSubtrees(Subtree left, Subtree right)
+{
+	if (!left.root) return right;
+	if (!right.root) return left;
+
+	Node* seamLeft = lastLeaf(left.root);
+	Node* seamRight = firstLeaf(right.root);
+
+	seamLeft->leaf().nextLeaf = seamRight;
+	seamRight->leaf().prevLeaf = seamLeft;
+
+	Key separator = separatorBetween(seamLeft->leaf().key(seamLeft->leaf().size() - 1), seamRight->leaf().key(0));
+
+	if (left.height == right.height) {
+		Node* root = allocateNode(false);
+		auto &children = root->internal().children;
+
+		children.push_back(left.root);
+		children.push_back(right.root);
+		root->internal().keys.push_back(std::move(separator));
+		refreshChildren(root);
+
+		while (children.size() == 2 && (underflows(children[0]) || underflows(children[1]))) {
+			fill(root, underflows(children[0]) ? 0 : 1);
+		}
+
+		if (children.size() == 1) {
+			Node* only = children[0];
+
+			releaseNode(root);
+
+			return { only, left.height };
+		}
+
+		return { root, left.height + 1 };
+	}
+
+	const bool leftTaller = left.height > right.height;
+	Subtree tall = leftTaller ? left : right;
+	Subtree small = leftTaller ? right : left;
+
+	// grow the taller tree first if its root is full, so the attach cannot overflow it
+	if (isFull(tall.root)) {
+		Node* root = allocateNode(false);
+
+		root->internal().children.push_back(tall.root);
+		splitChild(root, 0);
+		tall = { root, tall.height + 1 };
+	}
+
+	boost::container::small_vector<Node*, 16> spine{ tall.root };
+	Node* node = tall.root;
+
+	// walk down the spine facing the smaller tree to the level right above its root
+	for (size_t level = tall.height; level > small.height + 1; --level) {
+		size_t idx = leftTaller ? node->internal().children.size() - 1 : 0;
+
+		if (isFull(node->internal().children[idx])) {
+			splitChild(node, idx);
+
+			if (leftTaller) {
+				++idx;
+			}
+		}
+
+		node = node->internal().children[idx];
+		spine.push_back(node);
+	}
+
+	auto &children = node->internal().children;
+
+	if (leftTaller) {
+		node->internal().keys.push_back(std::move(separator));
+		children.push_back(small.root);
+
+		while (children.size() > 1 && underflows(children.back())) {
+			fill(node, children.size() - 1);
+		}
+	} else {
+		trivial_insert(node->internal().keys, 0, std::move(separator));
+		trivial_insert(children, 0, small.root);
+
+		while (children.size() > 1 && underflows(children.front())) {
+			fill(node, 0);
+		}
+	}
+
+	refreshChildren(node);
+
+	for (size_t level = spine.size() - 1; level > 0; --level) {
+		Node* parent = spine[level - 1];
+
+		refreshChild(parent, leftTaller ? parent->internal().children.size() - 1 : 0);
+	}
+
+	return tall;
+}
+
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+size_t BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::eraseRange(const Key &low, const Key &high)
+{
+	if (m_Size == 0 || less(high, low)) {
+		return 0;
+	}
+
+	auto [before, rest] = splitSubtree({ m_Root, height() }, low, false);
+	Subtree after{ nullptr, 0 };
+	size_t removed = 0;
+
+	if (rest.root) {
+		auto [covered, tail] = splitSubtree(rest, high, true);
+
+		removed = destroyNode(covered.root);
+		after = tail;
+	}
+
+	Subtree joined = joinSubtrees(before, after);
+
+	if (!joined.root) {
+		joined.root = allocateNode(true);
+	}
+
+	m_Root = joined.root;
+	collapseRoot();
+	m_LastLeaf = lastLeaf(m_Root);
+	m_Size -= removed;
+
+	return removed;
+}
+
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>
+BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::split(const Key &key)
+{
+	if (m_Compact.active) {
+		compact();
+	}
+
+	size_t moved = 0;
+
+	if constexpr (s_ORDER_STATS) {
+		moved = m_Size - rank(key);
+	}
+
+	auto [before, from] = splitSubtree({ m_Root, height() }, key, false);
+
+	if constexpr (!s_ORDER_STATS) {
+		// count whichever side ends first, walking the leaves outward from the seam
+		Node* left = before.root ? lastLeaf(before.root) : nullptr;
+		Node* right = from.root ? firstLeaf(from.root) : nullptr;
+		size_t leftCount = 0;
+		size_t rightCount = 0;
+
+		while (left && right) {
+			leftCount += left->leaf().size();
+			rightCount += right->leaf().size();
+			left = left->leaf().prevLeaf;
+			right = right->leaf().nextLeaf;
+		}
+
+		moved = left ? rightCount : m_Size - leftCount;
+	}
+
+	m_Root = before.root ? before.root : allocateNode(true);
+	collapseRoot();
+	m_LastLeaf = lastLeaf(m_Root);
+	m_Size -= moved;
+
+	BTree rest(m_Comp, m_nodePool, from.root, moved);
+
+	rest.collapseRoot();
+
+	return rest;
+}
+
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+void BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::join(BTree &&other)
+{
+	if (this == &other || other.m_Size == 0) {
+		return;
+	}
+
+	if (m_Compact.active) {
+		compact();
+	}
+
+	if (other.m_Compact.active) {
+		other.compact();
+	}
+
+	const bool append = m_Size == 0 || less(m_LastLeaf->leaf().key(m_LastLeaf->leaf().size() - 1), firstLeaf(other.m_Root)->leaf().key(0));
+
+	if (!append && !less(other.m_LastLeaf->leaf().key(other.m_LastLeaf->leaf().size() - 1), firstLeaf(m_Root)->leaf().key(0))) {
+		throw std::invalid_argument("BTree::join requires trees with disjoint key ranges");
+	}
+
+	Subtree theirs{ other.m_Root, other.height() };
+
+	if (other.m_nodePool != m_nodePool) {
+		if (other.m_nodePool.use_count() == 1) {
+			m_nodePool->adopt(*other.m_nodePool);
+			other.m_nodePool = std::make_shared<NodePool>();
+		} else {
+			Node* prevLeaf = nullptr;
+
+			theirs.root = adoptSubtree(theirs.root, *other.m_nodePool, prevLeaf);
+		}
+	}
+
+	// an empty tree is a lone empty leaf, which does not take part in the join
+	Subtree ours{ m_Size ? m_Root : nullptr, height() };
+
+	if (!ours.root) {
+		releaseNode(m_Root);
+	}
+
+	Subtree joined = append ? joinSubtrees(ours, theirs) : joinSubtrees(theirs, ours);
+
+	m_Root = joined.root;
+	collapseRoot();
+	m_LastLeaf = lastLeaf(m_Root);
+	m_Size += other.m_Size;
+
+	other.m_Root = other.allocateNode(true);
+	other.m_LastLeaf = other.m_Root;
+	other.m_Size = 0;
+}
+
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+typename BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::Node*
+BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::adoptSubtree(Node* node, NodePool &from, Node* &prevLeaf)
+{
+	Node* fresh = allocateNode(node->isLeaf);
+
+	if (node->isLeaf) {
+		fresh->leaf() = std::move(node->leaf());
+		fresh->leaf().prevLeaf = prevLeaf;
+		fresh->leaf().nextLeaf = nullptr;
+
+		if (prevLeaf) {
+			prevLeaf->leaf().nextLeaf = fresh;
+		}
+
+		prevLeaf = fresh;
+	} else {
+		fresh->internal() = std::move(node->internal());
+
+		for (auto &child : fresh->internal().children) {
+			child = adoptSubtree(child, from, prevLeaf);
+		}
+	}
+
+	from.release(node);
+
+	return fresh;
+}
+
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+void BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::mergeFrom(BTree &&other, BTreeConflictPolicy policy)
+{
+	if (policy == BTreeConflictPolicy::KeepLeft) {
+		mergeTrees(std::move(other), [](Value &, Value &&) {});
+	} else {
+		mergeTrees(std::move(other), [](Value &left, Value &&right) { left = std::move(right); });
+	}
+}
+
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+template <typename Combine>
+void BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::mergeFrom(BTree &&other, Combine combine)
+{
+	mergeTrees(std::move(other), [&combine](Value &left, Value &&right) {
+		left = combine(std::as_const(left), std::as_const(right));
+	});
+}
+
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+template <typename Resolve>
+void BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::mergeTrees(BTree &&other, Resolve resolve)
+{
+	if (this == &other || other.m_Size == 0) {
+		return;
+	}
+
+	// every entry of a tiny tree shifts at most one leaf of the large one, which beats moving all of them
+	if (std::min(m_Size, other.m_Size) * BTree::s_LEAF_MAX_KEYS <= std::max(m_Size, other.m_Size)) {
+		const bool swapped = m_Size < other.m_Size;
+
+		if (swapped) {
+			swapContents(other);
+		}
+
+		std::vector<std::pair<Key, Value>> fresh;
+		std::vector<PathEntry> path;
+
+		fresh.reserve(other.m_Size);
+
+		for (Node* leaf = firstLeaf(other.m_Root); leaf; leaf = leaf->leaf().nextLeaf) {
+			for (size_t i = 0; i < leaf->leaf().size(); ++i) {
+				const Key &key = leaf->leaf().key(i);
+				Node* node = m_Root;
+
+				path.clear();
+
+				while (!node->isLeaf) {
+					size_t c = childIndex(node, key);
+
+					path.push_back({ node, c, nullptr });
+					node = node->internal().children[c];
+				}
+
+				size_t idx = leafLowerBound(node, key);
+
+				if (!leafHolds(node, idx, key)) {
+					fresh.emplace_back(key, std::move(leaf->leaf().value(i)));
+					continue;
+				}
+
+				Value &existing = node->leaf().value(idx);
+
+				if (swapped) {
+					// the tree walked here is the left one
+					resolve(leaf->leaf().value(i), std::move(existing));
+					existing = std::move(leaf->leaf().value(i));
+				} else {
+					resolve(existing, std::move(leaf->leaf().value(i)));
+				}
+
+				// the resolved value feeds the summaries above its leaf
+				if constexpr (s_AGGREGATE) {
+					refreshPath(path);
+				}
+			}
+		}
+
+		insertBatch(fresh);
+		other.resetToEmpty();
+
+		return;
+	}
+
+	Node* left = firstLeaf(m_Root);
+	Node* right = firstLeaf(other.m_Root);
+	size_t li = 0;
+	size_t ri = 0;
+
+	Node* head = allocateNode(true);
+	Node* tail = head;
+	size_t count = 0;
+
+	try {
+		while (true) {
+			// step past exhausted leaves, the root leaf of an empty tree included
+			while (left && li == left->leaf().size()) {
+				left = left->leaf().nextLeaf;
+				li = 0;
+			}
+
+			while (right && ri == right->leaf().size()) {
+				right = right->leaf().nextLeaf;
+				ri = 0;
+			}
+
+			if (!left && !right) {
+				break;
+			}
+
+			Node* from;
+			size_t at;
+
+			if (!right || (left && less(left->leaf().key(li), right->leaf().key(ri)))) {
+				from = left;
+				at = li++;
+			} else if (!left || less(right->leaf().key(ri), left->leaf().key(li))) {
+				from = right;
+				at = ri++;
+			} else {
+				resolve(left->leaf().value(li), std::move(right->leaf().value(ri)));
+				from = left;
+				at = li++;
+				++ri;
+			}
+
+			if (tail->leaf().size() == BTree::s_LEAF_MAX_KEYS) {
+				Node* leaf = allocateNode(true);
+
+				tail->leaf().nextLeaf = leaf;
+				leaf->leaf().prevLeaf = tail;
+				tail = leaf;
+			}
+
+			tail->leaf().insert(tail->leaf().size(), std::move(from->leaf().key(at)), std::move(from->leaf().value(at)));
+			++count;
+		}
+	} catch (...) {
+		for (Node* n = head; n;) {
+			Node* next = n->leaf().nextLeaf;
+
+			releaseNode(n);
+			n = next;
+		}
+
+		// keys were moved out of both trees, neither is ordered anymore
+		resetToEmpty();
+		other.resetToEmpty();
+
+		throw;
+	}
+
+	adoptLeafChain(head, tail, count, BTree::s_MAX_CHILDREN);
+	other.resetToEmpty();
+}
+
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+template <typename Callback>
+size_t BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::intersect(const BTree &other, Callback callback) const
+{
+	size_t reported = 0;
+
+	mergeWalk<true, true>(other,
+		[](const Key &, const Value &) {},
+		[](const Key &, const Value &) {},
+		[&](const Key &key, const Value &left, const Value &) {
+			callback(key, left);
+			++reported;
+		});
+
+	return reported;
+}
 
-	if (childFull) {
-		splitChild(node, i);
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+template <typename Callback>
+size_t BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::difference(const BTree &other, Callback callback) const
+{
+	size_t reported = 0;
 
-		if (less(node->internal.keys[i], key))
-		{
-			++i;
-		}
-	}
+	mergeWalk<false, true>(other,
+		[&](const Key &key, const Value &value) {
+			callback(key, value);
+			++reported;
+		},
+		[](const Key &, const Value &) {},
+		[](const Key &, const Value &, const Value &) {});
 
-	return insertNonFull(node->internal.children[i], key, value);
+	return reported;
 }
 
-template <typename Key, typename Value, typename Compare>
-bool BTree<Key, Value, Compare>::insert(const Key& key, const Value& value)
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+template <typename Callback>
+size_t BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::symmetricDifference(const BTree &other, Callback callback) const
 {
-	bool rootFull = m_Root->isLeaf ? (m_Root->leaf.entries.size() >= BTree::s_MAX_KEYS) : (m_Root->internal.keys.size() >= BTree::s_MAX_KEYS);
+	size_t reported = 0;
+	auto report = [&](const Key &key, const Value &value) {
+		callback(key, value);
+		++reported;
+	};
 
-	if (rootFull) {
-		Node* oldRoot = m_Root;
-		Node* newRoot = allocateNode(false);
+	mergeWalk<false, false>(other, report, report, [](const Key &, const Value &, const Value &) {});
 
-		newRoot->internal.children.push_back(oldRoot);
-		splitChild(newRoot, 0);
-		m_Root = newRoot;
-	}
+	return reported;
+}
 
-	bool inserted = insertNonFull(m_Root, key, value);
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+template <typename Callback>
+size_t BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::join(const BTree &other, Callback callback) const
+{
+	size_t reported = 0;
 
-	if (inserted) {
-		++m_Size;
-	}
+	mergeWalk<true, true>(other,
+		[](const Key &, const Value &) {},
+		[](const Key &, const Value &) {},
+		[&](const Key &key, const Value &left, const Value &right) {
+			callback(key, left, right);
+			++reported;
+		});
 
-	return inserted;
+	return reported;
 }
 
-template <typename Key, typename Value, typename Compare>
-Value* BTree<Key, Value, Compare>::search(const Key& key) const
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+template <bool SkipLeft, bool SkipRight, typename OnLeft, typename OnRight, typename OnBoth>
+void BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::mergeWalk(const BTree &other, OnLeft onLeft, OnRight onRight, OnBoth onBoth) const
 {
-	Node* node = m_Root;
-
-	while (!node->isLeaf) {
-		auto *base = node->internal.keys.data();
-		size_t len = node->internal.keys.size();
-
-		// binary-search over the contiguous buffer
-		auto *pos = std::lower_bound(
-			base,
-			base + len,
-			key,
-			m_Comp
-		);
+	// an empty tree is a lone empty leaf
+	LeafCursor left{ m_Size ? firstLeaf(m_Root) : nullptr, 0 };
+	LeafCursor right{ other.m_Size ? firstLeaf(other.m_Root) : nullptr, 0 };
+
+	auto step = [](LeafCursor &cursor) {
+		if (++cursor.index == cursor.leaf->leaf().size()) {
+			cursor.leaf = cursor.leaf->leaf().nextLeaf;
+			cursor.index = 0;
+		}
+	};
 
-		size_t idx = pos - base;
+	while (left.leaf && right.leaf) {
+		const Key &leftKey = left.leaf->leaf().key(left.index);
+		const Key &rightKey = right.leaf->leaf().key(right.index);
 
-		node = node->internal.children[idx];
+		if (less(leftKey, rightKey)) {
+			if constexpr (SkipLeft) {
+				seek(left, rightKey);
+			} else {
+				onLeft(leftKey, left.leaf->leaf().value(left.index));
+				step(left);
+			}
+		} else if (less(rightKey, leftKey)) {
+			if constexpr (SkipRight) {
+				other.seek(right, leftKey);
+			} else {
+				onRight(rightKey, right.leaf->leaf().value(right.index));
+				step(right);
+			}
+		} else {
+			onBoth(leftKey, left.leaf->leaf().value(left.index), right.leaf->leaf().value(right.index));
+			step(left);
+			step(right);
+		}
 	}
 
-	for (auto& entry : node->leaf.entries) {
-		if (!less(entry.first, key) && !less(key, entry.first)) {
-			return &entry.second;
+	if constexpr (!SkipLeft) {
+		for (; left.leaf; step(left)) {
+			onLeft(left.leaf->leaf().key(left.index), left.leaf->leaf().value(left.index));
 		}
+	}
 
-		if (less(key, entry.first)) {
-			break ;
+	if constexpr (!SkipRight) {
+		for (; right.leaf; step(right)) {
+			onRight(right.leaf->leaf().key(right.index), right.leaf->leaf().value(right.index));
 		}
 	}
-
-	return nullptr;
 }
 
-
-template <typename Key, typename Value, typename Compare>
-bool BTree<Key, Value, Compare>::remove(const Key& key)
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+void BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::seek(LeafCursor &cursor, const Key &key) const
 {
-	if (!m_Root)
-		return false;
+	Node* leaf = cursor.leaf;
 
-	removeFromNode(m_Root, key);
-
-	--m_Size;
+	if (less(leaf->leaf().key(leaf->leaf().size() - 1), key)) {
+		Node* next = leaf->leaf().nextLeaf;
 
-	// if root is internal and now empty, delete it
-	if (!m_Root->isLeaf && m_Root->internal.keys.empty()) {
-		Node *old = m_Root;
+		// more than a leaf behind: a descent costs less than walking the chain
+		if (next && less(next->leaf().key(next->leaf().size() - 1), key)) {
+			leaf = findLeaf(key);
+		} else {
+			leaf = next;
+		}
+	}
 
-		m_Root = m_Root->internal.children.front();
+	size_t index = leaf ? leafLowerBound(leaf, key) : 0;
 
-		old->~Node();
+	// the key may fall between this leaf and the next one
+	if (leaf && index == leaf->leaf().size()) {
+		leaf = leaf->leaf().nextLeaf;
+		index = 0;
 	}
 
-	return true;
+	cursor = LeafCursor{ leaf, index };
 }
 
-template <typename Key, typename Value, typename Compare>
-Key BTree<Key, Value, Compare>::getPredecessor(Node *node, size_t idx) const
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+void BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::swapContents(BTree &other)
 {
-	Node *cur = node->internal.children[idx];
-
-	while (!cur->isLeaf) {
-		cur = cur->internal.children.back();
-	}
-
-	return cur->leaf.entries.back().first;
+	std::swap(m_Root, other.m_Root);
+	std::swap(m_LastLeaf, other.m_LastLeaf);
+	std::swap(m_Comp, other.m_Comp);
+	std::swap(m_Size, other.m_Size);
+	std::swap(m_nodePool, other.m_nodePool);
+	std::swap(m_Compact, other.m_Compact);
 }
 
-template <typename Key, typename Value, typename Compare>
-Key BTree<Key, Value, Compare>::getSuccessor(Node *node, size_t idx) const
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+void BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::resetToEmpty()
 {
-	Node *cur = node->internal.children[idx + 1];
-
-	while (!cur->isLeaf) {
-		cur = cur->internal.children.front();
-	}
-
-	return cur->leaf.entries.front().first;
+	destroyNode(m_Root);
+	m_Root = allocateNode(true);
+	m_LastLeaf = m_Root;
+	m_Size = 0;
 }
 
-template <typename Key, typename Value, typename Compare>
-void BTree<Key, Value, Compare>::fill(Node *node, size_t idx)
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+void BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::fill(Node *node, size_t idx)
 {
-	Node *child = node->internal.children[idx];
+	size_t last = node->internal().children.size() - 1;
 
 	// try borrow from left sibling
-	if (idx > 0 && ((node->internal.children[idx - 1]->isLeaf
-		? node->internal.children[idx - 1]->leaf.entries.size()
-		: node->internal.children[idx - 1]->internal.keys.size()) >= BTree::s_CAPACITY))
+	if (idx > 0 && canLend(node->internal().children[idx - 1]))
 	{
 		borrowFromPrev(node, idx);
 	}
 	// else try borrow from right sibling
-	else if (idx < node->internal.keys.size() && ((node->internal.children[idx + 1]->isLeaf
-		? node->internal.children[idx + 1]->leaf.entries.size()
-		: node->internal.children[idx + 1]->internal.keys.size()) >= BTree::s_CAPACITY))
+	else if (idx < last && canLend(node->internal().children[idx + 1]))
 	{
 		borrowFromNext(node, idx);
 	}
 	// else merge with a sibling
-	else
+	else if (idx > 0)
+	{
+		mergeNodes(node, idx - 1);
+	}
+	else if (idx < last)
 	{
-		if (idx < node->internal.keys.size())
-			mergeNodes(node, idx);
-		else
-			mergeNodes(node, idx - 1);
+		mergeNodes(node, idx);
+	}
+}
+
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+void BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::eraseChild(Node* parent, size_t index)
+{
+	InternalNode &in = parent->internal();
+
+	in.children.erase(in.children.begin() + index);
+
+	if (!in.keys.empty()) {
+		in.keys.erase(in.keys.begin() + (index > 0 ? index - 1 : 0));
 	}
 }
 
-template <typename Key, typename Value, typename Compare>
-void BTree<Key, Value, Compare>::borrowFromPrev(Node *node, size_t idx)
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+void BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::borrowFromPrev(Node *node, size_t idx)
 {
-	Node *child = node->internal.children[idx];
-	Node *left = node->internal.children[idx - 1];
+	Node *child = node->internal().children[idx];
+	Node *left = node->internal().children[idx - 1];
 
 	if (child->isLeaf)
 	{
 		// steal one entry from left leaf
-		child->leaf.entries.insert(
-			child->leaf.entries.begin(),
-			std::move(left->leaf.entries.back())
-		);
+		size_t last = left->leaf().size() - 1;
 
-		left->leaf.entries.pop_back();
+		child->leaf().insert(0, std::move(left->leaf().key(last)), std::move(left->leaf().value(last)));
+		left->leaf().erase(last);
 		// update parent key
-		node->internal.keys[idx - 1] = child->leaf.entries.front().first;
+		node->internal().keys[idx - 1] = separatorBetween(left->leaf().key(left->leaf().size() - 1), child->leaf().key(0));
 	}
 	else
 	{
 		// steal one key+child from left internal
-		child->internal.keys.insert(child->internal.keys.begin(), node->internal.keys[idx - 1]);
-		node->internal.keys[idx - 1] = left->internal.keys.back();
-		left->internal.keys.pop_back();
+		child->internal().keys.insert(child->internal().keys.begin(), node->internal().keys[idx - 1]);
+		node->internal().keys[idx - 1] = left->internal().keys.back();
+		left->internal().keys.pop_back();
 
-		child->internal.children.insert(
-			child->internal.children.begin(),
-			left->internal.children.back());
+		child->internal().children.insert(
+			child->internal().children.begin(),
+			left->internal().children.back());
 
-		left->internal.children.pop_back();
+		left->internal().children.pop_back();
 	}
+
+	refreshChild(node, idx - 1);
+	refreshChild(node, idx);
 }
 
-template <typename Key, typename Value, typename Compare>
-void BTree<Key, Value, Compare>::borrowFromNext(Node *node, size_t idx)
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+void BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::borrowFromNext(Node *node, size_t idx)
 {
-	Node *child = node->internal.children[idx];
-	Node *right = node->internal.children[idx + 1];
+	Node *child = node->internal().children[idx];
+	Node *right = node->internal().children[idx + 1];
 
 	if (child->isLeaf)
 	{
 		// steal one entry from right leaf
-		child->leaf.entries.push_back(std::move(right->leaf.entries.front()));
-		right->leaf.entries.erase(right->leaf.entries.begin());
+		child->leaf().insert(child->leaf().size(), std::move(right->leaf().key(0)), std::move(right->leaf().value(0)));
+		right->leaf().erase(0);
 		// update parent key
-		node->internal.keys[idx] = right->leaf.entries.front().first;
+		node->internal().keys[idx] = separatorBetween(child->leaf().key(child->leaf().size() - 1), right->leaf().key(0));
 	}
 	else
 	{
 		// steal one key+child from right internal
-		child->internal.keys.push_back(node->internal.keys[idx]);
-		node->internal.keys[idx] = right->internal.keys.front();
-		right->internal.keys.erase(right->internal.keys.begin());
+		child->internal().keys.push_back(node->internal().keys[idx]);
+		node->internal().keys[idx] = right->internal().keys.front();
+		right->internal().keys.erase(right->internal().keys.begin());
 
-		child->internal.children.push_back(right->internal.children.front());
-		right->internal.children.erase(right->internal.children.begin());
+		child->internal().children.push_back(right->internal().children.front());
+		right->internal().children.erase(right->internal().children.begin());
 	}
+
+	refreshChild(node, idx);
+	refreshChild(node, idx + 1);
 }
 
-template <typename Key, typename Value, typename Compare>
-void BTree<Key, Value, Compare>::mergeNodes(Node *node, size_t idx)
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+void BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::mergeNodes(Node *node, size_t idx)
 {
-	Node *left = node->internal.children[idx];
-	Node *right = node->internal.children[idx + 1];
+	Node *left = node->internal().children[idx];
+	Node *right = node->internal().children[idx + 1];
 
 	if (left->isLeaf)
 	{
 		// merge leaf entries
-		left->leaf.entries.insert(
-			left->leaf.entries.end(),
-			std::make_move_iterator(right->leaf.entries.begin()),
-			std::make_move_iterator(right->leaf.entries.end()));
+		right->leaf().moveTail(0, left->leaf());
 
 		// stitch leaf list
-		left->nextLeaf = right->nextLeaf;
+		left->leaf().nextLeaf = right->leaf().nextLeaf;
+
+		if (right->leaf().nextLeaf)
+			right->leaf().nextLeaf->leaf().prevLeaf = left;
 
-		if (right->nextLeaf)
-			right->nextLeaf->prevLeaf = left;
+		if (m_LastLeaf == right)
+			m_LastLeaf = left;
 	}
 	else
 	{
 		// pull down the separating key
-		left->internal.keys.push_back(node->internal.keys[idx]);
+		left->internal().keys.push_back(node->internal().keys[idx]);
 		// append right’s keys and children
-		left->internal.keys.insert(
-			left->internal.keys.end(),
-			right->internal.keys.begin(),
-			right->internal.keys.end()
+		left->internal().keys.insert(
+			left->internal().keys.end(),
+			right->internal().keys.begin(),
+			right->internal().keys.end()
 		);
 
-		left->internal.children.insert(
-			left->internal.children.end(),
-			right->internal.children.begin(),
-			right->internal.children.end()
+		left->internal().children.insert(
+			left->internal().children.end(),
+			right->internal().children.begin(),
+			right->internal().children.end()
 		);
 	}
 
 	// remove right sibling
-	node->internal.children.erase(node->internal.children.begin() + idx + 1);
-	node->internal.keys.erase(node->internal.keys.begin() + idx);
+	node->internal().children.erase(node->internal().children.begin() + idx + 1);
+	node->internal().keys.erase(node->internal().keys.begin() + idx);
 
-	right->~Node();
+	releaseNode(right);
+	refreshChild(node, idx);
 }
 
-template <typename Key, typename Value, typename Compare>
-void BTree<Key, Value, Compare>::removeFromNode(Node *node, const Key &key)
-{
-	// 1) Find the first index ≥ key
-	size_t idx = 0;
-	while (idx < node->internal.keys.size() && less(node->internal.keys[idx], key))
-		++idx;
-
-	// 2) Case A: key is in this node (and node is leaf or internal)
-	if (idx < node->internal.keys.size() && !less(key, node->internal.keys[idx]) && !less(node->internal.keys[idx], key))
-	{
-		if (node->isLeaf)
-		{
-			// A1) Leaf: erase the entry
-			auto eit = std::find_if(
-				node->leaf.entries.begin(),
-				node->leaf.entries.end(),
-				[&](auto const &p)
-				{ return !less(p.first, key) && !less(key, p.first); });
-
-			if (eit != node->leaf.entries.end())
-			{
-				node->leaf.entries.erase(eit);
-			}
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+void BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::rebalanceLeaf(Node* leaf, Node* parent, size_t index) {
+	if constexpr (BTree::s_MERGE_WHEN_EMPTY) {
+		if (leaf->leaf().prevLeaf) {
+			leaf->leaf().prevLeaf->leaf().nextLeaf = leaf->leaf().nextLeaf;
 		}
-		else
-		{
-			// A2) Internal: three subcases
-			Node *leftChild = node->internal.children[idx];
-			Node *rightChild = node->internal.children[idx + 1];
-			size_t leftCount = leftChild->isLeaf ? leftChild->leaf.entries.size()
-							: leftChild->internal.keys.size();
-			size_t rightCount = rightChild->isLeaf ? rightChild->leaf.entries.size()
-							: rightChild->internal.keys.size();
-
-			if (leftCount >= BTree::s_CAPACITY)
-			{
-				Key pred = getPredecessor(node, idx);
 
-				node->internal.keys[idx] = pred;
-				removeFromNode(leftChild, pred);
-			}
-			else if (rightCount >= BTree::s_CAPACITY)
-			{
-				Key succ = getSuccessor(node, idx);
-
-				node->internal.keys[idx] = succ;
-				removeFromNode(rightChild, succ);
-			}
-			else
-			{
-				// both children have only CAPACITY-1 keys → merge
-				mergeNodes(node, idx);
-				removeFromNode(leftChild, key);
-			}
-		}
-	}
-	// 3) Case B: key not in this node
-	else
-	{
-		if (node->isLeaf)
-		{
-			return;
+		if (leaf->leaf().nextLeaf) {
+			leaf->leaf().nextLeaf->leaf().prevLeaf = leaf->leaf().prevLeaf;
 		}
 
-		bool lastChild = (idx == node->internal.keys.size());
-		Node *child = node->internal.children[idx];
-		size_t childCount = child->isLeaf ? child->leaf.entries.size()
-						: child->internal.keys.size();
-
-		// ensure child has at least CAPACITY keys
-		if (childCount < BTree::s_CAPACITY)
-		{
-			fill(node, idx);
+		if (m_LastLeaf == leaf) {
+			m_LastLeaf = leaf->leaf().prevLeaf;
 		}
 
-		// after fill(), decide correct subtree
-		if (lastChild && idx > node->internal.keys.size())
-			removeFromNode(node->internal.children[idx - 1], key);
-		else
-			removeFromNode(node->internal.children[idx], key);
+		eraseChild(parent, index);
+		releaseNode(leaf);
+	} else {
+		fill(parent, index);
 	}
 }
 
-template <typename Key, typename Value, typename Compare>
-void BTree<Key, Value, Compare>::rebalanceLeaf(Node* leaf, Node* parent, size_t index) {
-	const size_t minEntries = BTree::s_CAPACITY - 1;
-	Node* left = index > 0 ? parent->children[index - 1] : nullptr;
-	Node* right = index + 1 < parent->children.size() ? parent->children[index + 1] : nullptr;
-
-	if (left && left->entries.size() > minEntries) {
-		auto kv = left->entries.back();
-
-		left->entries.pop_back();
-		leaf->entries.insert(leaf->entries.begin(), std::move(kv));
-		parent->keys[index - 1] = leaf->entries.front().first;
-
-		return ;
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+void BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::rebalanceInternal(Node* node, Node* parent, size_t index) {
+	if constexpr (BTree::s_MERGE_WHEN_EMPTY) {
+		eraseChild(parent, index);
+		releaseNode(node);
+	} else {
+		fill(parent, index);
 	}
+}
 
-	if (right && right->entries.size() > minEntries) {
-		auto kv = right->entries.front();
-		// right->entries.pop_front();
-		right->entries.erase(right->entries.begin());
-		leaf->entries.push_back(kv);
-		parent->keys[index] = right->entries.front().first;
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+typename BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::RangeEntries BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::range(const Key &low, const Key &high)
+{
+	RangeEntries out;
 
-		return;
+	for (auto [key, value] : rangeView(low, high)) {
+		if constexpr (s_PREFIX_LEAVES) {
+			out.emplace_back(std::move(key), &value);
+		} else {
+			out.emplace_back(&key, &value);
+		}
 	}
 
-	if (left) {
-		left->entries.insert(
-			left->entries.end(),
-			std::make_move_iterator(leaf->entries.begin()),
-			std::make_move_iterator(leaf->entries.end())
-		);
+	return out;
+}
 
-		leaf->entries.clear();
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+typename BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::RangeEntries BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::range(const Key &low, size_t count)
+{
+	RangeEntries out;
 
-		left->nextLeaf = leaf->nextLeaf;
+	out.reserve(std::min(count, m_Size));
 
-		if (leaf->nextLeaf) {
-			leaf->nextLeaf->prevLeaf = left;
+	for (auto [key, value] : rangeView(low, count)) {
+		if constexpr (s_PREFIX_LEAVES) {
+			out.emplace_back(std::move(key), &value);
+		} else {
+			out.emplace_back(&key, &value);
 		}
+	}
 
-		parent->children.erase(parent->children.begin() + index);
-		parent->keys.erase(parent->keys.begin() + index - 1);
-
-		leaf->~Node();
-	} else {
-		leaf->entries.insert(
-			leaf->entries.end(),
-			std::make_move_iterator(right->entries.begin()),
-			std::make_move_iterator(right->entries.end())
-		);
-
-		right->entries.clear();
-
-		leaf->nextLeaf = right->nextLeaf;
-
-		if (right->nextLeaf) {
-			right->nextLeaf->prevLeaf = leaf;
-		}
+	return out;
+}
 
-		parent->children.erase(parent->children.begin() + index + 1);
-		parent->keys.erase(parent->keys.begin() + index);
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+auto BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::rangeView(const Key &low, const Key &high)
+{
+	Iterator last = upper_bound(high);
 
-		right->~Node();
+	// an inverted interval is empty; lower_bound(low) would start past `last`
+	if (less(high, low)) {
+		return std::ranges::subrange<Iterator>(last, last);
 	}
-}
 
-template <typename Key, typename Value, typename Compare>
-void BTree<Key, Value, Compare>::rebalanceInternal(Node* node, Node* parent, size_t index) {
-	const size_t minKeys = BTree::s_CAPACITY - 1;
-	Node* left = index > 0 ? parent->children[index - 1] : nullptr;
-	Node* right = index + 1 < parent->children.size() ? parent->children[index + 1] : nullptr;
+	return std::ranges::subrange<Iterator>(lower_bound(low), last);
+}
 
-	if (left && left->keys.size() > minKeys) {
-		Key sep = parent->keys[index - 1];
-		Node* c = left->children.back();
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+auto BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::rangeView(const Key &low, size_t count)
+{
+	return std::ranges::subrange<Iterator>(lower_bound(low), end())
+		| std::views::take(static_cast<std::ptrdiff_t>(std::min(count, m_Size)));
+}
 
-		left->children.pop_back();
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+typename BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::RangeEntries BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::rangeReverse(const Key &high, size_t count)
+{
+	RangeEntries out;
 
-		Key k2 = left->keys.back();
+	out.reserve(std::min(count, m_Size));
 
-		left->keys.pop_back();
+	for (auto [key, value] : rangeViewReverse(high, count)) {
+		if constexpr (s_PREFIX_LEAVES) {
+			out.emplace_back(std::move(key), &value);
+		} else {
+			out.emplace_back(&key, &value);
+		}
+	}
 
-		trivial_insert(node->children, 0, c);
-		trivial_insert(node->keys, 0, sep);
+	return out;
+}
 
-		parent->keys[index - 1] = k2;
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+auto BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::rangeViewReverse(const Key &low, const Key &high)
+{
+	return rangeView(low, high) | std::views::reverse;
+}
 
-		return ;
-	}
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+auto BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::rangeViewReverse(const Key &high, size_t count)
+{
+	return std::ranges::subrange<Iterator>(begin(), upper_bound(high))
+		| std::views::reverse
+		| std::views::take(static_cast<std::ptrdiff_t>(std::min(count, m_Size)));
+}
 
-	if (right && right->keys.size() > minKeys) {
-		Key sep = parent->keys[index];
-		Node* c = right->children.front();
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+std::vector<size_t> BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::bulkGroupSizes(size_t count, size_t target, size_t minSize, size_t maxSize)
+{
+	std::vector<size_t> sizes(count / target, target);
+	size_t rest = count % target;
 
-		trivial_erase(right->children, 0);
+	if (rest == 0)
+		return sizes;
 
-		Key k2 = right->keys.front();
+	if (sizes.empty() || rest >= minSize) {
+		sizes.push_back(rest);
+	} else if (sizes.back() + rest <= maxSize) {
+		sizes.back() += rest;
+	} else {
+		size_t total = sizes.back() + rest;
 
-		trivial_erase(right->keys, 0);
+		sizes.back() = total - total / 2;
+		sizes.push_back(total / 2);
+	}
 
-		node->children.push_back(c);
-		node->keys.push_back(sep);
-		parent->keys[index] = k2;
+	return sizes;
+}
 
-		return ;
-	}
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+typename BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::Node *
+BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::buildInternalLevels(std::vector<std::pair<Node*, Key>> &level, size_t fanout)
+{
+	while (level.size() > 1) {
+		std::vector<size_t> sizes = bulkGroupSizes(level.size(), fanout, BTree::s_INTERNAL_MIN_KEYS + 1, BTree::s_MAX_CHILDREN);
+		std::vector<std::pair<Node*, Key>> parents;
+		size_t pos = 0;
 
-	if (left) {
-		Key sep = parent->keys[index - 1];
+		parents.reserve(sizes.size());
 
-		left->keys.push_back(sep);
-		left->keys.insert(left->keys.end(), node->keys.begin(), node->keys.end());
-		left->children.insert(left->children.end(), node->children.begin(), node->children.end());
+		for (size_t size : sizes) {
+			Node* parent = allocateNode(false);
 
-		trivial_erase(parent->children, index);
-		trivial_erase(parent->keys, index - 1);
+			for (size_t c = 0; c < size; ++c) {
+				auto &[child, lowKey] = level[pos + c];
 
-		node->~Node();
-	} else {
-		Key sep = parent->keys[index];
+				// the first child's low key becomes the parent's own low key
+				if (c > 0)
+					parent->internal().keys.push_back(std::move(lowKey));
 
-		node->keys.push_back(sep);
-		node->keys.insert(node->keys.end(), right->keys.begin(), right->keys.end());
-		node->children.insert(node->children.end(), right->children.begin(), right->children.end());
+				parent->internal().children.push_back(child);
+			}
 
-		trivial_erase(parent->children, index + 1);
-		trivial_erase(parent->keys, index);
+			refreshChildren(parent);
+			parents.emplace_back(parent, std::move(level[pos].second));
+			pos += size;
+		}
 
-		right->~Node();
+		level = std::move(parents);
 	}
+
+	return level.front().first;
 }
 
-template <typename Key, typename Value, typename Compare>
-std::vector<std::pair<const Key *, Value *>> BTree<Key, Value, Compare>::range(const Key &low, const Key &high)
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+void BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::adoptLeafChain(Node* head, Node* tail, size_t count, size_t fanout)
 {
-	std::vector<std::pair<const Key *, Value *>> out;
-
-	if (!m_Root)
-		return out;
-
-	// 1) Search down to the leaf that could contain `low`
-	Node *n = m_Root;
-
-	while (!n->isLeaf) {
-		auto it = std::upper_bound(
-			n->internal.keys.begin(), n->internal.keys.end(), low,
-			[this](auto const &a, auto const &b) { return m_Comp(a, b); }
-		);
-		size_t childIdx = std::distance(n->internal.keys.begin(), it);
+	// Even out the last two leaves if the last one is underfull
+	if (Node* prev = tail->leaf().prevLeaf; prev && tail->leaf().size() < BTree::s_LEAF_MIN_KEYS) {
+		if (prev->leaf().size() + tail->leaf().size() <= BTree::s_LEAF_MAX_KEYS) {
+			tail->leaf().moveTail(0, prev->leaf());
+			prev->leaf().nextLeaf = nullptr;
+			releaseNode(tail);
+			tail = prev;
+		} else {
+			size_t total = prev->leaf().size() + tail->leaf().size();
+			LeafNode moved;
 
-		n = n->internal.children[childIdx];
+			prev->leaf().moveTail(total - total / 2, moved);
+			tail->leaf().moveTail(0, moved);
+			moved.moveTail(0, tail->leaf());
+		}
 	}
 
-	// 2) In that leaf, find the first entry >= low
-	auto entryIt = std::lower_bound(
-		n->leaf.entries.begin(), n->leaf.entries.end(), low,
-		[this](std::pair<Key, Value> const &entry, auto const &val)
-		{ return m_Comp(entry.first, val); });
+	// Build the internal levels bottom-up
+	Node* root = head;
 
-	size_t idx = std::distance(n->leaf.entries.begin(), entryIt);
+	if (head->leaf().nextLeaf) {
+		std::vector<std::pair<Node*, Key>> level;
 
-	// 3) Collect until > high, hopping leaves as needed
-	while (n) {
-		while (idx < n->leaf.entries.size()) {
-			auto &kv = n->leaf.entries[idx];
+		level.emplace_back(head, head->leaf().key(0));
 
-			if (m_Comp(high, kv.first)) // kv.first > high ?
-				return out;
-
-			out.emplace_back(&kv.first, &kv.second);
-			++idx;
+		for (Node* n = head->leaf().nextLeaf; n; n = n->leaf().nextLeaf) {
+			level.emplace_back(n, separatorBetween(n->leaf().prevLeaf->leaf().key(n->leaf().prevLeaf->leaf().size() - 1), n->leaf().key(0)));
 		}
 
-		n = n->nextLeaf;
-		idx = 0;
+		root = buildInternalLevels(level, fanout);
 	}
 
-	return out;
+	destroyNode(m_Root);
+	m_Root = root;
+	m_LastLeaf = tail;
+	m_Size = count;
 }
 
-template <typename Key, typename Value, typename Compare>
-std::vector<std::pair<const Key *, Value *>> BTree<Key, Value, Compare>::range(const Key &low, size_t count)
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+template <typename InputIt>
+void BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::bulkLoad(InputIt first, InputIt last, double fillFactor)
 {
-	std::vector<std::pair<const Key *, Value *>> out;
-
-	if (!m_Root || count == 0)
-		return out;
-
-	// 1) Descend to leaf
-	Node *n = m_Root;
-
-	while (!n->isLeaf) {
-		auto it = std::upper_bound(
-			n->internal.keys.begin(), n->internal.keys.end(), low,
-			[this](auto const &a, auto const &b) { return m_Comp(a, b); }
-		);
-
-		n = n->internal.children[std::distance(n->internal.keys.begin(), it)];
-	}
+	const size_t leafTarget = std::clamp<size_t>(
+		static_cast<size_t>(BTree::s_LEAF_MAX_KEYS * fillFactor + 0.5),
+		std::max<size_t>(BTree::s_LEAF_MIN_KEYS, 1),
+		BTree::s_LEAF_MAX_KEYS);
+	const size_t fanout = std::clamp<size_t>(
+		static_cast<size_t>(BTree::s_MAX_CHILDREN * fillFactor + 0.5),
+		BTree::s_INTERNAL_MIN_KEYS + 1,
+		BTree::s_MAX_CHILDREN);
+
+	Node* head = allocateNode(true);
+	Node* tail = head;
+	size_t count = 0;
+
+	// Pack the entries into a chain of leaves, the internal levels come last
+	try {
+		for (; first != last; ++first) {
+			auto &&[key, value] = *first;
+
+			if (!tail->leaf().empty()) {
+				size_t lastIdx = tail->leaf().size() - 1;
+
+				if (less(key, tail->leaf().key(lastIdx))) {
+					throw std::invalid_argument("BTree::bulkLoad requires input sorted by key");
+				}
+
+				// equal keys collapse into one entry holding the last value, like insert()
+				if (!less(tail->leaf().key(lastIdx), key)) {
+					tail->leaf().value(lastIdx) = value;
+
+					continue;
+				}
+			}
 
-	// 2) Find first >= low
-	auto entryIt = std::lower_bound(
-		n->leaf.entries.begin(), n->leaf.entries.end(), low,
-		[this](auto const &entry, auto const &val) { return m_Comp(entry.first, val); }
-	);
+			if (tail->leaf().size() == leafTarget) {
+				Node* leaf = allocateNode(true);
 
-	size_t idx = std::distance(n->leaf.entries.begin(), entryIt);
-	size_t taken = 0;
+				tail->leaf().nextLeaf = leaf;
+				leaf->leaf().prevLeaf = tail;
+				tail = leaf;
+			}
 
-	// 3) Collect up to count
-	while (n && taken < count) {
-		if (idx < n->leaf.entries.size()) {
-			auto &kv = n->leaf.entries[idx++];
-			out.push_back({&kv.first, &kv.second});
+			tail->leaf().insert(tail->leaf().size(), key, value);
+			++count;
+		}
+	} catch (...) {
+		for (Node* n = head; n;) {
+			Node* next = n->leaf().nextLeaf;
 
-			++taken;
-		} else {
-			n = n->nextLeaf;
-			idx = 0;
+			releaseNode(n);
+			n = next;
 		}
+
+		throw;
 	}
 
-	return out;
+	adoptLeafChain(head, tail, count, fanout);
 }
 
-template <typename Key, typename Value, typename Compare>
-bool BTree<Key, Value, Compare>::move(const Key &from, const Key &to)
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+bool BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::move(const Key &from, const Key &to)
 {
-	const Value* value = this->search(from);
+	const Value* found = this->search(from);
 
-	if (!value)
+	if (!found)
 	{
 		return false;
 	}
 
+	// the slot is gone once `from` is removed
+	Value value = *found;
+
 	this->remove(from);
-	this->insert(to, *value);
+	this->insert(to, value);
 
 	return true;
 }
 
 #ifdef BTREE_ENABLE_JSON
 
-template <typename Key, typename Value, typename Compare>
-std::string BTree<Key, Value, Compare>::serializeToJson() const
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+std::string BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::serializeToJson() const
 {
 	using json = nlohmann::ordered_json;
 
@@ -892,9 +2659,12 @@ std::string BTree<Key, Value, Compare>::serializeToJson() const
 
 		// entries: [ [key,value], [key,value], … ]
 		j["entries"] = json::array();
-		for (auto const &[k, v] : node->leaf.entries)
+		if (node->isLeaf)
 		{
-			j["entries"].push_back(json::array({k, v}));
+			for (size_t i = 0; i < node->leaf().size(); ++i)
+			{
+				j["entries"].push_back(json::array({node->leaf().key(i), node->leaf().value(i)}));
+			}
 		}
 
 		// children: recurse or empty array for leaves
@@ -902,13 +2672,13 @@ std::string BTree<Key, Value, Compare>::serializeToJson() const
 
 		if (!node->isLeaf)
 		{
-			for (Node *child : node->internal.children)
+			for (Node *child : node->internal().children)
 			{
 				j["children"].push_back(dumpNode(child));
 			}
 		} else {
-			json prev = node->prevLeaf ? json(ptrToHex(node->prevLeaf)) : json(nullptr);
-			json next = node->nextLeaf ? json(ptrToHex(node->nextLeaf)) : json(nullptr);
+			json prev = node->leaf().prevLeaf ? json(ptrToHex(node->leaf().prevLeaf)) : json(nullptr);
+			json next = node->leaf().nextLeaf ? json(ptrToHex(node->leaf().nextLeaf)) : json(nullptr);
 
 			j["prev"] = std::move(prev);
 			j["next"] = std::move(next);
@@ -926,45 +2696,43 @@ std::string BTree<Key, Value, Compare>::serializeToJson() const
 
 #endif
 
-template <typename Key, typename Value, typename Compare>
-BTree<Key, Value, Compare>::Iterator::Iterator() noexcept :
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::Iterator::Iterator() noexcept :
 	m_Tree(nullptr),
 	m_CurrentNode(nullptr),
 	m_CurrentIndex(0) {}
 
-template <typename Key, typename Value, typename Compare>
-BTree<Key, Value, Compare>::Iterator::Iterator(BTree *tree, Node *node, size_t index) noexcept :
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::Iterator::Iterator(BTree *tree, Node *node, size_t index) noexcept :
 	m_Tree(tree),
 	m_CurrentNode(node),
 	m_CurrentIndex(index) {}
 
-template <typename Key, typename Value, typename Compare>
-std::pair<const Key &, Value &> BTree<Key, Value, Compare>::Iterator::operator*() const
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+std::pair<typename BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::KeyReference, Value &> BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::Iterator::operator*() const
 {
-	auto &kv = m_CurrentNode->leaf.entries[m_CurrentIndex];
-
-	return { kv.first, kv.second };
+	return { m_CurrentNode->leaf().key(m_CurrentIndex), m_CurrentNode->leaf().value(m_CurrentIndex) };
 }
 
-template <typename Key, typename Value, typename Compare>
-typename BTree<Key, Value, Compare>::Iterator& BTree<Key, Value, Compare>::Iterator::operator++()
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+typename BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::Iterator& BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::Iterator::operator++()
 {
 	if (!m_CurrentNode)
 	{
 		return *this;
 	}
 
-	if (++m_CurrentIndex >= m_CurrentNode->leaf.entries.size())
+	if (++m_CurrentIndex >= m_CurrentNode->leaf().size())
 	{
-		m_CurrentNode = m_CurrentNode->nextLeaf;
+		m_CurrentNode = m_CurrentNode->leaf().nextLeaf;
 		m_CurrentIndex = 0;
 	}
 
 	return *this;
 }
 
-template <typename Key, typename Value, typename Compare>
-typename BTree<Key, Value, Compare>::Iterator BTree<Key, Value, Compare>::Iterator::operator++(int)
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+typename BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::Iterator BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::Iterator::operator++(int)
 {
 	Iterator tmp = *this;
 
@@ -973,22 +2741,18 @@ typename BTree<Key, Value, Compare>::Iterator BTree<Key, Value, Compare>::Iterat
 	return tmp;
 }
 
-template <typename Key, typename Value, typename Compare>
-typename BTree<Key, Value, Compare>::Iterator &BTree<Key, Value, Compare>::Iterator::operator--()
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+typename BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::Iterator &BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::Iterator::operator--()
 {
+	// from end(): the last entry of the rightmost leaf
 	if (!m_CurrentNode)
 	{
-		Node *n = m_Tree->m_Root;
-
-		while (n && !n->isLeaf)
-		{
-			n = n->children.back();
-		}
+		Node *n = m_Tree->m_LastLeaf;
 
-		if (n && !n->entries.empty())
+		if (!n->leaf().empty())
 		{
 			m_CurrentNode = n;
-			m_CurrentIndex = n->entries.size() - 1;
+			m_CurrentIndex = n->leaf().size() - 1;
 		}
 
 		return *this;
@@ -1003,16 +2767,16 @@ typename BTree<Key, Value, Compare>::Iterator &BTree<Key, Value, Compare>::Itera
 	}
 
 	// at index 0, hop to previous leaf
-	Node *prev = m_CurrentNode->prevLeaf;
+	Node *prev = m_CurrentNode->leaf().prevLeaf;
 
 	m_CurrentNode = prev;
-	m_CurrentIndex = prev ? prev->entries.size() - 1 : 0;
+	m_CurrentIndex = prev ? prev->leaf().size() - 1 : 0;
 
 	return *this;
 }
 
-template <typename Key, typename Value, typename Compare>
-typename BTree<Key, Value, Compare>::Iterator BTree<Key, Value, Compare>::Iterator::operator--(int)
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+typename BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::Iterator BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::Iterator::operator--(int)
 {
 	Iterator tmp = *this;
 
@@ -1021,44 +2785,212 @@ typename BTree<Key, Value, Compare>::Iterator BTree<Key, Value, Compare>::Iterat
 	return tmp;
 }
 
-template <typename Key, typename Value, typename Compare>
-bool BTree<Key, Value, Compare>::Iterator::operator==(Iterator const &o) const
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+bool BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::Iterator::operator==(Iterator const &o) const
 {
 	return m_CurrentNode == o.m_CurrentNode && m_CurrentIndex == o.m_CurrentIndex;
 }
 
-template <typename Key, typename Value, typename Compare>
-bool BTree<Key, Value, Compare>::Iterator::operator!=(Iterator const &o) const
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+bool BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::Iterator::operator!=(Iterator const &o) const
 {
 	return !(*this == o);
 }
 
-template <typename Key, typename Value, typename Compare>
-typename BTree<Key, Value, Compare>::Iterator BTree<Key, Value, Compare>::begin()
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+typename BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::Iterator BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::begin()
 {
 	Node* n = m_Root;
 
 	while (n && !n->isLeaf) {
-		n = n->internal.children.front();
+		n = n->internal().children.front();
+	}
+
+	return iteratorAt(n, 0);
+}
+
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+typename BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::Iterator BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::lower_bound(const Key &key)
+{
+	Node* n = findLeaf(key);
+
+	return iteratorAt(n, leafLowerBound(n, key));
+}
+
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+typename BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::Iterator BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::upper_bound(const Key &key)
+{
+	Node* n = findLeaf(key);
+	size_t idx = leafLowerBound(n, key);
+
+	if (leafHolds(n, idx, key)) {
+		++idx;
+	}
+
+	return iteratorAt(n, idx);
+}
+
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+typename BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::Iterator BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::find(const Key &key)
+{
+	Node* n = findLeaf(key);
+	size_t idx = leafLowerBound(n, key);
+
+	if (leafHolds(n, idx, key)) {
+		return Iterator(this, n, idx);
+	}
+
+	return end();
+}
+
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+auto BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::equal_range(const Key &key) -> std::pair<Iterator, Iterator>
+{
+	Node* n = findLeaf(key);
+	size_t idx = leafLowerBound(n, key);
+	Iterator first = iteratorAt(n, idx);
+
+	if (leafHolds(n, idx, key)) {
+		return { first, iteratorAt(n, idx + 1) };
 	}
 
-	return Iterator(this, n, 0);
+	return { first, first };
 }
 
-template <typename Key, typename Value, typename Compare>
-typename BTree<Key, Value, Compare>::Iterator BTree<Key, Value, Compare>::end() noexcept
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+typename BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::Iterator BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::end() noexcept
 {
 	return Iterator(this, nullptr, 0);
 }
 
-template <typename Key, typename Value, typename Compare>
-auto BTree<Key, Value, Compare>::rbegin() -> std::reverse_iterator<BTree<Key, Value, Compare>::Iterator>
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+size_t BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::countBelow(const Key &key, bool inclusive) const
+{
+	size_t below = 0;
+	Node* n = m_Root;
+
+	while (!n->isLeaf) {
+		size_t idx = childIndex(n, key);
+
+		for (size_t c = 0; c < idx; ++c) {
+			below += n->internal().children[c].count;
+		}
+
+		n = n->internal().children[idx];
+	}
+
+	size_t idx = leafLowerBound(n, key);
+
+	if (inclusive && leafHolds(n, idx, key)) {
+		++idx;
+	}
+
+	return below + idx;
+}
+
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+size_t BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::rank(const Key &key) const
+{
+	static_assert(s_ORDER_STATS, "BTree::rank requires Traits::orderStatistics");
+
+	return countBelow(key, false);
+}
+
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+typename BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::Iterator BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::select(size_t k)
+{
+	static_assert(s_ORDER_STATS, "BTree::select requires Traits::orderStatistics");
+
+	if (k >= m_Size) {
+		return end();
+	}
+
+	Node* n = m_Root;
+
+	while (!n->isLeaf) {
+		size_t c = 0;
+
+		while (k >= n->internal().children[c].count) {
+			k -= n->internal().children[c].count;
+			++c;
+		}
+
+		n = n->internal().children[c];
+	}
+
+	return Iterator(this, n, k);
+}
+
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+size_t BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::count(const Key &low, const Key &high) const
+{
+	static_assert(s_ORDER_STATS, "BTree::count requires Traits::orderStatistics");
+
+	if (less(high, low)) {
+		return 0;
+	}
+
+	return countBelow(high, true) - countBelow(low, false);
+}
+
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+typename BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::AggregateValue BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::aggregateNode(const Node* node, const Key* low, const Key* high) const
+{
+	// an unbounded subtree is fully covered
+	if (!low && !high) {
+		return subtreeAggregate(node);
+	}
+
+	AggregateValue total = Aggregate::identity();
+
+	if (node->isLeaf) {
+		size_t i = low ? leafLowerBound(node, *low) : 0;
+
+		for (; i < node->leaf().size() && !(high && less(*high, node->leaf().key(i))); ++i) {
+			total = Aggregate::combine(total, Aggregate::lift(node->leaf().key(i), node->leaf().value(i)));
+		}
+
+		return total;
+	}
+
+	const InternalNode &in = node->internal();
+	size_t first = low ? childIndex(node, *low) : 0;
+	size_t last = high ? childIndex(node, *high) : in.children.size() - 1;
+
+	// both bounds fall into the same child, nothing in this node is fully covered yet
+	if (first == last) {
+		return aggregateNode(in.children[first], low, high);
+	}
+
+	total = aggregateNode(in.children[first], low, nullptr);
+
+	for (size_t c = first + 1; c < last; ++c) {
+		total = Aggregate::combine(total, in.children[c].aggregate);
+	}
+
+	return Aggregate::combine(total, aggregateNode(in.children[last], nullptr, high));
+}
+
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+typename BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::AggregateValue BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::aggregate(const Key &low, const Key &high) const
+{
+	static_assert(s_AGGREGATE, "BTree::aggregate requires Traits::Aggregate");
+
+	if (less(high, low)) {
+		return Aggregate::identity();
+	}
+
+	return aggregateNode(m_Root, &low, &high);
+}
+
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+auto BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::rbegin() -> std::reverse_iterator<BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::Iterator>
 {
-	return std::reverse_iterator<BTree<Key, Value, Compare>::Iterator>(end());
+	return std::reverse_iterator<BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::Iterator>(end());
 }
 
-template <typename Key, typename Value, typename Compare>
-auto BTree<Key, Value, Compare>::rend() noexcept -> std::reverse_iterator<BTree<Key, Value, Compare>::Iterator>
+template <typename Key, typename Value, typename Compare, size_t LeafCapacity, size_t InternalCapacity, typename Traits>
+auto BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::rend() noexcept -> std::reverse_iterator<BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::Iterator>
 {
-	return std::reverse_iterator<BTree<Key, Value, Compare>::Iterator>(begin());
+	return std::reverse_iterator<BTree<Key, Value, Compare, LeafCapacity, InternalCapacity, Traits>::Iterator>(begin());
 }
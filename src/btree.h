@@ -1,14 +1,248 @@
 #pragma once
 
 #include <vector>
+#include <deque>
+#include <algorithm>
 #include <cstddef>
 #include <functional>
 #include <string>
 #include <cstring>
+#include <cstdint>
 #include <type_traits>
 #include <memory>
+#include <span>
+#include <string_view>
+#include <optional>
+#include <utility>
+#include <ranges>
+#include <bit>
+#include <mutex>
+#include <new>
 #include "boost/container/small_vector.hpp"
 
+#if defined(__AVX2__)
+#define BTREE_SIMD_AVX2 1
+#elif defined(__SSE4_2__) || defined(__AVX__)
+#define BTREE_SIMD_SSE4 1
+#endif
+
+#if defined(BTREE_SIMD_AVX2) || defined(BTREE_SIMD_SSE4)
+#include <immintrin.h>
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define BTREE_PREFETCH(addr) __builtin_prefetch(addr)
+#elif defined(_MSC_VER)
+#include <intrin.h>
+#define BTREE_PREFETCH(addr) _mm_prefetch(reinterpret_cast<const char *>(addr), _MM_HINT_T0)
+#else
+#define BTREE_PREFETCH(addr) ((void)(addr))
+#endif
+
+/**
+ * @brief Fixed-capacity array stored inline in a node: a `uint16_t` count followed
+ *        by raw storage for `N` elements, with the subset of the vector interface the
+ *        tree uses.
+ *
+ * Unlike a small vector it keeps no pointer or capacity and never allocates, so the
+ * count and the first elements share a cache line. Nodes never hold more than `N`
+ * elements; exceeding the capacity is a logic error.
+ *
+ * @tparam T  Type of the elements.
+ * @tparam N  Maximum number of elements.
+*/
+template <typename T, size_t N>
+class BTreeInlineVector
+{
+	static_assert(N <= UINT16_MAX, "node capacities are counted in 16 bits");
+
+	public:
+		using value_type = T;
+		using iterator = T*;
+		using const_iterator = const T*;
+
+		BTreeInlineVector() = default;
+
+		BTreeInlineVector(const BTreeInlineVector &other)
+		{
+			std::uninitialized_copy(other.begin(), other.end(), begin());
+			m_Count = other.m_Count;
+		}
+
+		BTreeInlineVector(BTreeInlineVector &&other) noexcept
+		{
+			std::uninitialized_move(other.begin(), other.end(), begin());
+			m_Count = other.m_Count;
+			other.clear();
+		}
+
+		BTreeInlineVector& operator=(const BTreeInlineVector &other)
+		{
+			if (this != &other) {
+				assign(other.begin(), other.end());
+			}
+
+			return *this;
+		}
+
+		BTreeInlineVector& operator=(BTreeInlineVector &&other) noexcept
+		{
+			if (this != &other) {
+				clear();
+				std::uninitialized_move(other.begin(), other.end(), begin());
+				m_Count = other.m_Count;
+				other.clear();
+			}
+
+			return *this;
+		}
+
+		~BTreeInlineVector() { clear(); }
+
+		T* data() { return std::launder(reinterpret_cast<T*>(m_Storage)); }
+		const T* data() const { return std::launder(reinterpret_cast<const T*>(m_Storage)); }
+
+		iterator begin() { return data(); }
+		iterator end() { return data() + m_Count; }
+		const_iterator begin() const { return data(); }
+		const_iterator end() const { return data() + m_Count; }
+
+		size_t size() const { return m_Count; }
+		bool empty() const { return m_Count == 0; }
+		static constexpr size_t capacity() { return N; }
+
+		T& operator[](size_t i) { return data()[i]; }
+		const T& operator[](size_t i) const { return data()[i]; }
+		T& front() { return data()[0]; }
+		const T& front() const { return data()[0]; }
+		T& back() { return data()[m_Count - 1]; }
+		const T& back() const { return data()[m_Count - 1]; }
+
+		template <typename... Args>
+		T& emplace_back(Args&&... args)
+		{
+			T* slot = new (data() + m_Count) T(std::forward<Args>(args)...);
+
+			++m_Count;
+
+			return *slot;
+		}
+
+		void push_back(const T &value) { emplace_back(value); }
+		void push_back(T &&value) { emplace_back(std::move(value)); }
+
+		void pop_back()
+		{
+			--m_Count;
+			std::destroy_at(data() + m_Count);
+		}
+
+		/**
+		 * @brief Constructs an element at `pos`, shifting the tail up by one slot
+		 *        (one memmove for trivially-copyable elements).
+		*/
+		template <typename... Args>
+		iterator emplace(const_iterator pos, Args&&... args)
+		{
+			const size_t i = pos - begin();
+
+			if (i == m_Count) {
+				emplace_back(std::forward<Args>(args)...);
+			} else if constexpr (std::is_trivially_copyable_v<T>) {
+				T value(std::forward<Args>(args)...);
+
+				std::memmove(data() + i + 1, data() + i, (m_Count - i) * sizeof(T));
+				new (data() + i) T(value);
+				++m_Count;
+			} else {
+				// the arguments may refer into the array, build the element before shifting
+				T value(std::forward<Args>(args)...);
+
+				new (data() + m_Count) T(std::move(back()));
+				std::move_backward(begin() + i, end() - 1, end());
+				data()[i] = std::move(value);
+				++m_Count;
+			}
+
+			return begin() + i;
+		}
+
+		iterator insert(const_iterator pos, const T &value) { return emplace(pos, value); }
+		iterator insert(const_iterator pos, T &&value) { return emplace(pos, std::move(value)); }
+
+		template <typename InputIt>
+		iterator insert(const_iterator pos, InputIt first, InputIt last)
+		{
+			const size_t i = pos - begin();
+			const size_t oldCount = m_Count;
+
+			for (; first != last; ++first) {
+				emplace_back(*first);
+			}
+
+			std::rotate(begin() + i, begin() + oldCount, end());
+
+			return begin() + i;
+		}
+
+		iterator erase(const_iterator pos) { return erase(pos, pos + 1); }
+
+		iterator erase(const_iterator first, const_iterator last)
+		{
+			const size_t i = first - begin();
+			const size_t count = last - first;
+
+			if (count == 0) {
+				return begin() + i;
+			}
+
+			if constexpr (std::is_trivially_copyable_v<T>) {
+				std::memmove(data() + i, data() + i + count, (m_Count - i - count) * sizeof(T));
+			} else {
+				std::move(begin() + i + count, end(), begin() + i);
+				std::destroy(end() - count, end());
+			}
+
+			m_Count -= static_cast<uint16_t>(count);
+
+			return begin() + i;
+		}
+
+		void clear()
+		{
+			std::destroy(begin(), end());
+			m_Count = 0;
+		}
+
+		template <typename InputIt>
+		void assign(InputIt first, InputIt last)
+		{
+			clear();
+
+			for (; first != last; ++first) {
+				emplace_back(*first);
+			}
+		}
+
+		/**
+		 * @brief Grows or shrinks to `count` elements, value-initializing new ones.
+		*/
+		void resize(size_t count)
+		{
+			while (m_Count > count) {
+				pop_back();
+			}
+
+			while (m_Count < count) {
+				emplace_back();
+			}
+		}
+
+	private:
+		uint16_t m_Count{0};
+		alignas(T) unsigned char m_Storage[N * sizeof(T)];
+};
+
 /**
  * @brief Inserts a value into a vector at a given index using a fast
  *        memmove for trivially-copyable types, and falls back to the
@@ -17,14 +251,10 @@
  * 		  trivially‐copyable elements—using a single block memmove (or pop_back) instead of expensive per‐element shifts
  *
  * @tparam T
- *   Type of the elements stored in the small_vector.
+ *   Type of the elements stored in the vector.
  *
  * @tparam N
- * 	 The size of the small_vector to use.
- *
- * @tparam Options
- *
- * 	 Options to pass to boost::container::small_vector
+ * 	 The capacity of the vector.
  *
  * @param vec
  *   The container into which the element will be inserted.
@@ -43,8 +273,8 @@
  *   - For non-trivial T, this calls vec.insert(...) to
  *     preserve correct construction and destruction semantics.
 */
-template <typename T, size_t N, typename... Options>
-inline void trivial_insert(boost::container::small_vector<T, N, Options...> &vec, size_t index, T const &value);
+template <typename T, size_t N>
+inline void trivial_insert(BTreeInlineVector<T, N> &vec, size_t index, std::type_identity_t<T> const &value);
 
 /**
  * @brief Appends a contiguous range of elements from a raw pointer into a
@@ -54,14 +284,10 @@ inline void trivial_insert(boost::container::small_vector<T, N, Options...> &vec
  * 		  trivially‐copyable elements—using a single block memmove (or pop_back) instead of expensive per‐element shifts
  *
  * @tparam T
- *   Type of the elements stored in the small_vector.
+ *   Type of the elements stored in the vector.
  *
  * @tparam N
- * 	 The size of the small_vector to use.
- *
- * @tparam Options
- *
- * 	 Options to pass to boost::container::small_vector
+ * 	 The capacity of the vector.
  *
  * @param dst
  *   The destination container to which elements will be appended.
@@ -83,8 +309,8 @@ inline void trivial_insert(boost::container::small_vector<T, N, Options...> &vec
  *     src, src+count)` so that copy/move constructors and destructors are
  *     properly invoked.
 */
-template <typename T, size_t N, typename... Options>
-inline void trivial_append_range(boost::container::small_vector<T, N, Options...> &dst, size_t dstStart, T const *src, size_t count);
+template <typename T, size_t N>
+inline void trivial_append_range(BTreeInlineVector<T, N> &dst, size_t dstStart, T const *src, size_t count);
 
 /**
  * @brief Erases the element at a given index from a vector using a single
@@ -94,14 +320,10 @@ inline void trivial_append_range(boost::container::small_vector<T, N, Options...
  * 		  trivially‐copyable elements—using a single block memmove (or pop_back) instead of expensive per‐element shifts
  *
  * @tparam T
- *   Type of the elements stored in the small_vector.
+ *   Type of the elements stored in the vector.
  *
  * @tparam N
- * 	 The size of the small_vector to use.
- *
- * @tparam Options
- *
- * 	 Options to pass to boost::container::small_vector
+ * 	 The capacity of the vector.
  *
  * @param vec
  *   The container from which the element will be removed.
@@ -115,168 +337,1341 @@ inline void trivial_append_range(boost::container::small_vector<T, N, Options...
  *   - For non-trivial T, this calls vec.erase(iterator)
  *     to invoke the correct destructor and shift semantics.
 */
-template <typename T, size_t N, typename... Options>
-inline void trivial_erase(boost::container::small_vector<T, N, Options...> &vec, size_t index);
+template <typename T, size_t N>
+inline void trivial_erase(BTreeInlineVector<T, N> &vec, size_t index);
 
 /**
- * @class BTree
- * @brief A templated B-Tree container for sorted key/value storage.
+ * @brief True when `simd_lower_bound`/`simd_upper_bound` have a vectorized kernel
+ *        for keys of type `Key` ordered by `Compare`.
  *
- * Maintains balance by splitting and merging nodes as elements are inserted
- * or removed, allowing efficient logarithmic-time operations.
+ * Only the natural ordering (`std::less<Key>` or `std::less<>`) of `int`, `uint32_t`,
+ * `int64_t` and `double` is covered. Every other key type or comparator goes
+ * through `std::lower_bound`/`std::upper_bound` with the tree's comparator.
+ *
+ * @tparam Key     Type of the keys stored in the tree.
+ * @tparam Compare Functor used to order keys.
+*/
+template <typename Key, typename Compare>
+inline constexpr bool btree_simd_searchable =
+	(std::is_same_v<Compare, std::less<Key>> || std::is_same_v<Compare, std::less<>>) &&
+	(std::is_same_v<Key, int32_t> || std::is_same_v<Key, uint32_t> ||
+	 std::is_same_v<Key, int64_t> || std::is_same_v<Key, double>);
+
+/**
+ * @brief Returns the index of the first key in a sorted array that is not less
+ *        than `key`, i.e. the number of keys < `key`.
+ *
+ * Narrows the window with a binary search until it spans a couple of cache
+ * lines, then finishes with compare + movemask + popcount over whole vectors,
+ * stopping at the first vector that is not entirely below `key`. Uses AVX2 when
+ * compiled with it, SSE4.2 otherwise, and `std::lower_bound` when neither is
+ * available.
+ *
+ * @tparam T
+ *   One of `int32_t`, `uint32_t`, `int64_t` or `double`.
+ *
+ * @param keys
+ *   Pointer to the first key of an ascending array.
+ *
+ * @param n
+ *   Number of keys in the array.
+ *
+ * @param key
+ *   The key to look for.
+ *
+ * @return The lower-bound index in [0, n].
+*/
+template <typename T>
+inline size_t simd_lower_bound(const T *keys, size_t n, T key);
+
+/**
+ * @brief Returns the index of the first key in a sorted array that is greater
+ *        than `key`, i.e. the number of keys <= `key`.
+ *
+ * Same kernel as `simd_lower_bound` with an inclusive comparison; this is the
+ * child slot to descend into from an internal node.
+ *
+ * @tparam T
+ *   One of `int32_t`, `uint32_t`, `int64_t` or `double`.
+ *
+ * @param keys
+ *   Pointer to the first key of an ascending array.
+ *
+ * @param n
+ *   Number of keys in the array.
+ *
+ * @param key
+ *   The key to look for.
+ *
+ * @return The upper-bound index in [0, n].
+*/
+template <typename T>
+inline size_t simd_upper_bound(const T *keys, size_t n, T key);
+
+/**
+ * @brief Size in bytes of a cache line on the platforms we build for.
+*/
+inline constexpr size_t BTREE_CACHE_LINE = 64;
+
+/**
+ * @brief Number of cache lines a node is sized to span when the capacities
+ *        are derived from the key/value sizes.
+*/
+inline constexpr size_t BTREE_NODE_CACHE_LINES = 16;
+
+/**
+ * @brief Default maximum number of entries per leaf, picked so that one leaf's
+ *        entries span `BTREE_NODE_CACHE_LINES` cache lines.
+ *
+ * Small entries (int/int) get wide leaves, fat entries (int/std::string) get
+ * narrow ones. The result is clamped to [8, 255].
  *
  * @tparam Key     Type of the keys stored in the tree.
  * @tparam Value   Type of the values associated with each key.
- * @tparam Compare Functor used to order keys; defaults to `std::less<Key>`.
 */
-template <typename Key, typename Value, typename Compare = std::less<Key>>
-class BTree
+template <typename Key, typename Value>
+inline constexpr size_t BTreeDefaultLeafCapacity = std::clamp<size_t>(
+	BTREE_NODE_CACHE_LINES * BTREE_CACHE_LINE / sizeof(std::pair<Key, Value>), 8, 255);
+
+/**
+ * @brief Default maximum number of separator keys per internal node, picked so
+ *        that the keys and child pointers span `BTREE_NODE_CACHE_LINES` cache lines.
+ *
+ * The result is clamped to [8, 255].
+ *
+ * @tparam Key     Type of the keys stored in the tree.
+*/
+template <typename Key>
+inline constexpr size_t BTreeDefaultInternalCapacity = std::clamp<size_t>(
+	BTREE_NODE_CACHE_LINES * BTREE_CACHE_LINE / (sizeof(Key) + sizeof(void*)), 8, 255);
+
+/**
+ * @brief How a leaf node lays out its entries in memory.
+*/
+enum class BTreeLeafLayout
 {
-	public:
-		/**
-		 * @brief The maximum number of entries per node.
-		*/
-		static constexpr size_t s_CAPACITY = 16;
-		static constexpr size_t s_MAX_KEYS = 2 * s_CAPACITY - 1;
-		static constexpr size_t s_MAX_CHILDREN = 2 * s_CAPACITY;
+	/**
+	 * @brief One array of `std::pair<Key, Value>`; a key and its value share a cache line.
+	*/
+	ArrayOfPairs,
 
-		/**
-		 * @brief Constructs an empty B-Tree with a custom comparator.
-		 *
-		 * @param comp  A callable object that returns true if a < b.
-		 * 		Defaults to `std::less<Key>`
-		 */
-		explicit BTree(const Compare& comp = Compare{});
+	/**
+	 * @brief One array of keys and a parallel array of values. Searching a leaf only
+	 *        touches the keys, and arithmetic keys can use the SIMD search kernels.
+	*/
+	SplitKeysValues,
 
-		struct Node;
+	/**
+	 * @brief For `std::string` keys in their natural order: the prefix shared by all keys
+	 *        of a leaf is stored once, and only the suffixes are kept, back to back in one
+	 *        buffer per leaf. A lookup compares against the prefix once and then searches
+	 *        the suffixes. Keys are rebuilt on access, so iterators yield them by value
+	 *        and `range`/`rangeReverse` return the rebuilt keys along with the pointers.
+	*/
+	PrefixCompressed
+};
 
-		struct InternalNode
-		{
-			boost::container::small_vector<Key, s_MAX_KEYS> keys;
-			boost::container::small_vector<Node* , s_MAX_CHILDREN> children;
+/**
+ * @brief When `BTree::remove` restructures the tree after taking an entry out of a leaf.
+*/
+enum class BTreeUnderflowPolicy
+{
+	/**
+	 * @brief Classic B+-tree: a node that drops below half full borrows from a sibling
+	 *        or is merged with one, and the fix-up continues upward while parents underflow.
+	*/
+	Rebalance,
 
-			InternalNode() {
-				keys.reserve(s_MAX_KEYS);
-				children.reserve(s_MAX_CHILDREN);
-			}
+	/**
+	 * @brief Free-at-empty: a leaf is only unlinked once its last entry is gone, and an
+	 *        internal node once its last child is gone. Nodes may run below half full,
+	 *        which saves most of the restructuring work of delete-heavy workloads.
+	*/
+	MergeWhenEmpty
+};
 
-			~InternalNode() = default;
-		};
+/**
+ * @brief Which value `BTree::mergeFrom` keeps for a key present in both trees.
+*/
+enum class BTreeConflictPolicy
+{
+	/**
+	 * @brief Keep the value of the tree being merged into.
+	*/
+	KeepLeft,
 
-		struct LeafNode
-		{
-			boost::container::small_vector<std::pair<Key, Value>, s_MAX_KEYS + 1> entries;
+	/**
+	 * @brief Keep the value of the tree being merged from.
+	*/
+	KeepRight
+};
 
-			LeafNode() {
-				entries.reserve(s_MAX_KEYS + 1);
-			}
+/**
+ * @brief Placeholder aggregate policy of a tree that keeps no range aggregates.
+ *
+ * A user-defined policy is a monoid over the entries: `combine` has to be associative
+ * and `identity()` neutral for it, commutativity is not required.
+ *
+ * @code
+ * struct SumBytes {
+ *     using value_type = uint64_t;
+ *
+ *     static value_type identity() { return 0; }
+ *     static value_type combine(const value_type &a, const value_type &b) { return a + b; }
+ *     static value_type lift(const int64_t &time, const Sample &sample) { return sample.bytes; }
+ * };
+ *
+ * struct BytesPerWindow : BTreeDefaultTraits {
+ *     using Aggregate = SumBytes;
+ * };
+ * @endcode
+*/
+struct BTreeNoAggregate
+{
+	struct value_type {};
+};
 
-			~LeafNode() = default;
-		};
+/**
+ * @brief Placeholder abbreviation policy of a tree that compares full keys only.
+ *
+ * A user-defined policy maps a key to an order-preserving 64-bit abbreviation:
+ * `a < b` must imply `abbreviate(a) <= abbreviate(b)` under the tree's comparator.
+ * Keys with different abbreviations are then ordered by them alone, and the
+ * comparator only runs when two abbreviations tie.
+ *
+ * @code
+ * struct AbbreviatedKeys : BTreeDefaultTraits {
+ *     using Abbreviation = BTreeStringAbbreviation;
+ * };
+ * @endcode
+*/
+struct BTreeNoAbbreviation {};
 
-		/**
-		 * @struct Node
-		 * @brief Represents a single node in the B-Tree.
-		 *
-		 * Holds up to `BTree::s_MAX_KEYS` entries in a leaf.
-		 */
-		struct Node
-		{
-			union
-			{
-				InternalNode internal;
-				LeafNode leaf;
-			};
+/**
+ * @brief Abbreviation of `std::string` keys in their natural order: the first
+ *        8 bytes, big-endian and zero-padded, so that the integers compare like
+ *        the bytes do.
+*/
+struct BTreeStringAbbreviation
+{
+	static uint64_t abbreviate(const std::string &key)
+	{
+		uint64_t abbrev = 0;
+		size_t length = std::min<size_t>(key.size(), 8);
 
-			bool isLeaf;
-			Node* nextLeaf;
-			Node* prevLeaf;
+		for (size_t i = 0; i < length; ++i) {
+			abbrev |= uint64_t(static_cast<unsigned char>(key[i])) << (56 - 8 * i);
+		}
 
-			/**
-			 * @brief Constructs a node.
-			 *
-			 * @param leaf  If true, this node will act as a leaf; otherwise as an internal node.
-			*/
-			explicit Node(bool leaf);
-			~Node();
-		};
+		return abbrev;
+	}
+};
+
+/**
+ * @brief Compile-time options for a `BTree`. Derive from it and shadow the
+ *        members you want to change, then pass your struct as the `Traits`
+ *        template argument.
+ *
+ * @code
+ * struct SplitLeaves : BTreeDefaultTraits {
+ *     static constexpr BTreeLeafLayout leafLayout = BTreeLeafLayout::SplitKeysValues;
+ * };
+ *
+ * BTree<int, std::string, std::less<int>, 64, 128, SplitLeaves> tree;
+ * @endcode
+*/
+struct BTreeDefaultTraits
+{
+	/**
+	 * @brief Memory layout of the leaf entries.
+	*/
+	static constexpr BTreeLeafLayout leafLayout = BTreeLeafLayout::ArrayOfPairs;
+
+	/**
+	 * @brief Restructuring done by `remove` when a node underflows.
+	*/
+	static constexpr BTreeUnderflowPolicy underflowPolicy = BTreeUnderflowPolicy::Rebalance;
+
+	/**
+	 * @brief Keep the number of entries below each child pointer of an internal node,
+	 *        enabling `rank`, `select` and `count` in O(log n). Costs one extra word per
+	 *        child and a refresh of the counts along the path of every modification.
+	*/
+	static constexpr bool orderStatistics = false;
+
+	/**
+	 * @brief Aggregate policy kept per child of an internal node, enabling `aggregate`
+	 *        in O(log n). See `BTreeNoAggregate` for the expected members.
+	*/
+	using Aggregate = BTreeNoAggregate;
+
+	/**
+	 * @brief Abbreviation policy whose 64-bit key prefixes are stored next to every
+	 *        separator and leaf key and compared before the full keys. See
+	 *        `BTreeNoAbbreviation` for the expected member.
+	*/
+	using Abbreviation = BTreeNoAbbreviation;
+
+	/**
+	 * @brief Link child nodes and neighbouring leaves through 32-bit handles (pool block
+	 *        number and slot) instead of 8-byte pointers. Halves the link footprint of
+	 *        every node at the cost of a directory lookup per followed link.
+	*/
+	static constexpr bool compactHandles = false;
+
+	/**
+	 * @brief Cut the separators between leaves down to the shortest prefix of the right
+	 *        leaf's first key that still sorts after the left leaf's last key. Shorter
+	 *        separators compare faster in the descent; they are still `std::string`s.
+	 *        Requires `std::string` keys ordered by `std::less`.
+	*/
+	static constexpr bool truncateSeparators = false;
+};
+
+/**
+ * @class BTree
+ * @brief A templated B-Tree container for sorted key/value storage.
+ *
+ * Maintains balance by splitting and merging nodes as elements are inserted
+ * or removed, allowing efficient logarithmic-time operations.
+ *
+ * Non-root nodes hold at least `s_LEAF_MIN_KEYS` entries or `s_INTERNAL_MIN_KEYS`
+ * keys, with one exception: inserts past the last key split right-biased, so the
+ * new right sibling starts with a single entry (one key for internal nodes) and the
+ * right spine may stay below the minimum. Such a node is only brought back up when a
+ * removal makes it underflow again, and `join` can leave it inside the tree. Removal
+ * only needs a sibling that cannot lend to hold at most the minimum, which an
+ * underfull node does too, so every borrow or merge still fits.
+ *
+ * @tparam Key               Type of the keys stored in the tree.
+ * @tparam Value             Type of the values associated with each key.
+ * @tparam Compare           Functor used to order keys; defaults to `std::less<Key>`.
+ * @tparam LeafCapacity      Maximum number of entries in a leaf node.
+ * @tparam InternalCapacity  Maximum number of separator keys in an internal node
+ *                           (it has one more child than keys).
+ * @tparam Traits            Compile-time options, see `BTreeDefaultTraits`.
+*/
+template <
+	typename Key,
+	typename Value,
+	typename Compare = std::less<Key>,
+	size_t LeafCapacity = BTreeDefaultLeafCapacity<Key, Value>,
+	size_t InternalCapacity = BTreeDefaultInternalCapacity<Key>,
+	typename Traits = BTreeDefaultTraits>
+class BTree
+{
+	static_assert(LeafCapacity >= 3, "BTree leaves must hold at least 3 entries");
+	static_assert(InternalCapacity >= 3, "BTree internal nodes must hold at least 3 keys");
 
+	public:
 		/**
-		 * @brief Accesses the value associated with a key. This does a search behind the scenes
-		 * 	so don't use it for repeated access, instead loop over the iterator and do your custom
-		 * 	logic there.
-		 *
-		 * If the key exists, returns a reference to its value. Otherwise,
-		 * an out of range exception will be thrown
-		 *
-		 * @param key  The key to locate or insert.
-		 * @return Reference to the mapped value.
+		 * @brief The maximum number of entries per leaf node.
 		*/
-		Value& operator[](const Key& key);
+		static constexpr size_t s_LEAF_MAX_KEYS = LeafCapacity;
 
 		/**
-		 * @brief Returns the number of key/value pairs stored in the tree.
-		 *
-		 * This size of the B+Tree is updated during insertions and deletions and thus not computed.
-		 *
-		 * @return The number of entries in the tree.
+		 * @brief The minimum number of entries a non-root leaf keeps after a removal.
+		 *        Two leaves at the minimum always fit in one leaf when merged.
 		*/
-		size_t size() const;
+		static constexpr size_t s_LEAF_MIN_KEYS = LeafCapacity / 2;
 
 		/**
-		 * @brief Inserts a key/value pair into the tree.
-		 *
-		 * If the key does not already exist, a new node is created.
-		 * If the key exists, the insertion is skipped.
-		 *
-		 * @param key     The key to insert.
-		 * @param value   The value to associate with the key.
-		 * @return true if the pair was inserted; false if the key was already present.
+		 * @brief The maximum number of separator keys per internal node.
 		*/
-		bool insert(const Key &key, const Value &value);
+		static constexpr size_t s_INTERNAL_MAX_KEYS = InternalCapacity;
 
 		/**
-		 * @brief Searches for the value associated with a given key.
+		 * @brief The minimum number of separator keys a non-root internal node keeps
+		 *        after a removal. Two nodes at the minimum plus the separator pulled
+		 *        down from the parent always fit in one node when merged.
+		*/
+		static constexpr size_t s_INTERNAL_MIN_KEYS = (InternalCapacity - 1) / 2;
+		static constexpr size_t s_MAX_CHILDREN = InternalCapacity + 1;
+
+		/**
+		 * @brief Number of lookups `searchBatch` keeps in flight at once.
+		*/
+		static constexpr size_t s_BATCH_GROUP = 16;
+
+		/**
+		 * @brief True when leaves store keys and values in separate arrays.
+		*/
+		static constexpr bool s_SPLIT_LEAVES = Traits::leafLayout == BTreeLeafLayout::SplitKeysValues;
+
+		/**
+		 * @brief True when `remove` only frees nodes once they are empty.
+		*/
+		static constexpr bool s_MERGE_WHEN_EMPTY = Traits::underflowPolicy == BTreeUnderflowPolicy::MergeWhenEmpty;
+
+		/**
+		 * @brief True when internal nodes keep per-child subtree counts.
+		*/
+		static constexpr bool s_ORDER_STATS = Traits::orderStatistics;
+
+		/**
+		 * @brief Aggregate policy of the tree, `BTreeNoAggregate` if there is none.
+		*/
+		using Aggregate = typename Traits::Aggregate;
+
+		/**
+		 * @brief Result type of `aggregate`.
+		*/
+		using AggregateValue = typename Aggregate::value_type;
+
+		/**
+		 * @brief True when internal nodes keep per-child aggregates.
+		*/
+		static constexpr bool s_AGGREGATE = !std::is_same_v<Aggregate, BTreeNoAggregate>;
+
+		/**
+		 * @brief True when internal nodes keep any per-child summary that has to be
+		 *        refreshed after modifications.
+		*/
+		static constexpr bool s_AUGMENTED = s_ORDER_STATS || s_AGGREGATE;
+
+		/**
+		 * @brief Abbreviation policy of the tree, `BTreeNoAbbreviation` if there is none.
+		*/
+		using Abbreviation = typename Traits::Abbreviation;
+
+		/**
+		 * @brief True when searches compare key abbreviations before the full keys.
+		*/
+		static constexpr bool s_ABBREVIATED = !std::is_same_v<Abbreviation, BTreeNoAbbreviation>;
+
+		/**
+		 * @brief True when nodes link to each other through 32-bit handles instead of pointers.
+		*/
+		static constexpr bool s_COMPACT_HANDLES = Traits::compactHandles;
+
+		/**
+		 * @brief True when keys are `std::string`s compared in their natural, bytewise order,
+		 *        so that any key prefix can stand in for a key in comparisons.
+		*/
+		static constexpr bool s_STRING_KEYS = std::is_same_v<Key, std::string>
+			&& (std::is_same_v<Compare, std::less<std::string>> || std::is_same_v<Compare, std::less<>>);
+
+		/**
+		 * @brief True when the separators between leaves are cut down to the shortest
+		 *        prefix of the right leaf's first key that still sorts after the left
+		 *        leaf's last key, see `BTreeDefaultTraits::truncateSeparators`.
+		*/
+		static constexpr bool s_TRUNCATE_SEPARATORS = Traits::truncateSeparators;
+
+		static_assert(!s_TRUNCATE_SEPARATORS || s_STRING_KEYS,
+			"truncated separators need std::string keys ordered by std::less");
+
+		/**
+		 * @brief True when leaves store their shared key prefix once, see
+		 *        `BTreeLeafLayout::PrefixCompressed`.
+		*/
+		static constexpr bool s_PREFIX_LEAVES = Traits::leafLayout == BTreeLeafLayout::PrefixCompressed;
+
+		/**
+		 * @brief Bytes of key data (the prefix and the suffixes) a prefix-compressed leaf
+		 *        keeps inline. A leaf whose keys need more moves them to the heap.
+		*/
+		static constexpr size_t s_PREFIX_LEAF_BYTES = s_LEAF_MAX_KEYS * 16;
+
+		static_assert(!s_PREFIX_LEAVES || s_STRING_KEYS,
+			"prefix-compressed leaves need std::string keys ordered by std::less");
+
+		static_assert(!s_PREFIX_LEAVES || !s_ABBREVIATED,
+			"prefix-compressed leaves search their suffixes directly and keep no abbreviations");
+
+		/**
+		 * @brief What an iterator yields for the key of an entry: a reference into the leaf,
+		 *        or a copy rebuilt from prefix and suffix when leaves are prefix-compressed.
+		*/
+		using KeyReference = std::conditional_t<s_PREFIX_LEAVES, Key, const Key&>;
+
+		/**
+		 * @brief Constructs an empty B-Tree with a custom comparator.
+		 *
+		 * @param comp  A callable object that returns true if a < b.
+		 * 		Defaults to `std::less<Key>`
+		 */
+		explicit BTree(const Compare& comp = Compare{});
+
+		/**
+		 * @brief Constructs a B-Tree from a range sorted by key, see `bulkLoad`.
+		 *
+		 * @param first       Iterator to the first (key, value) pair.
+		 * @param last        Iterator one past the last pair.
+		 * @param fillFactor  Fraction of each node's capacity to fill, in (0, 1].
+		 * @param comp        A callable object that returns true if a < b.
+		 * @throws std::invalid_argument if the range is not sorted by key.
+		 */
+		template <typename InputIt>
+		BTree(InputIt first, InputIt last, double fillFactor = 1.0, const Compare& comp = Compare{});
+
+		/**
+		 * @brief Takes over the nodes of `other`, which is left empty.
+		 */
+		BTree(BTree &&other);
+
+		/**
+		 * @brief Releases this tree's nodes and takes over those of `other`, which is left empty.
+		 */
+		BTree& operator=(BTree &&other);
+
+		struct Node;
+
+		/**
+		 * Stand-in for a summary the tree does not keep.
+		 */
+		struct NoSummary {};
+
+		/**
+		 * A 32-bit link to a node: its pool block number above `s_SLOT_BITS` bits of slot
+		 * index, 0 for none. Like `SummarizedChild` it converts to and from `Node*`, so the
+		 * tree algorithms keep working on pointers. Block numbers come from the
+		 * `BlockDirectory` shared by all pools of the tree type, so handles stay valid
+		 * when blocks move between pools.
+		 */
+		struct NodeHandle
+		{
+			uint32_t index;
+
+			NodeHandle() : index(0) {}
+			NodeHandle(Node* n) : index(n ? n->handle : 0) {}
+
+			operator Node*() const { return BlockDirectory::resolve(index); }
+			Node* operator->() const { return BlockDirectory::resolve(index); }
+		};
+
+		using NodeLink = std::conditional_t<s_COMPACT_HANDLES, NodeHandle, Node*>;
+
+		/**
+		 * Links of a leaf to its neighbours in key order, the base of every leaf layout;
+		 * internal nodes carry none.
+		 */
+		struct LeafLinks
+		{
+			NodeLink nextLeaf = nullptr;
+			NodeLink prevLeaf = nullptr;
+		};
+
+		/**
+		 * A child pointer of an augmented internal node together with the summary of the
+		 * child's subtree. It converts to and from `Node*` so the tree algorithms handle it
+		 * like a plain pointer: constructing one from a pointer leaves the summary to be
+		 * refreshed, while assigning a pointer (relocating the same subtree) keeps it.
+		 */
+		struct SummarizedChild
+		{
+			NodeLink node;
+
+			/**
+			 * Number of entries in the subtree.
+			 */
+			[[no_unique_address]] std::conditional_t<s_ORDER_STATS, size_t, NoSummary> count;
+
+			/**
+			 * Aggregate of the entries in the subtree.
+			 */
+			[[no_unique_address]] AggregateValue aggregate;
+
+			SummarizedChild() : node(nullptr), count(), aggregate() {}
+			SummarizedChild(Node* n) : node(n), count(), aggregate() {}
+
+			SummarizedChild& operator=(Node* n)
+			{
+				node = n;
+
+				return *this;
+			}
+
+			operator Node*() const { return node; }
+			Node* operator->() const { return node; }
+		};
+
+		using ChildSlot = std::conditional_t<s_AUGMENTED, SummarizedChild, NodeLink>;
+
+		/**
+		 * A separator key together with its abbreviation. It is only built from a key,
+		 * so the abbreviation always matches the key it was computed from; the key is
+		 * read through `separatorKey` and moved out through `takeSeparatorKey`.
+		 */
+		struct AbbreviatedKey
+		{
+			uint64_t abbrev;
+			Key key;
+
+			AbbreviatedKey() : abbrev(0), key() {}
+			AbbreviatedKey(const Key &k) : abbrev(Abbreviation::abbreviate(k)), key(k) {}
+			AbbreviatedKey(Key &&k) : abbrev(Abbreviation::abbreviate(k)), key(std::move(k)) {}
+		};
+
+		using SeparatorKey = std::conditional_t<s_ABBREVIATED, AbbreviatedKey, Key>;
+
+		/**
+		 * Abbreviations of the keys of a leaf, parallel to them, when the tree keeps any.
+		 */
+		using LeafAbbrevs = std::conditional_t<s_ABBREVIATED,
+			BTreeInlineVector<uint64_t, s_LEAF_MAX_KEYS + 1>, NoSummary>;
+
+		struct InternalNode
+		{
+			BTreeInlineVector<SeparatorKey, s_INTERNAL_MAX_KEYS> keys;
+			BTreeInlineVector<ChildSlot, s_MAX_CHILDREN> children;
+		};
+
+		/**
+		 * @brief Leaf storage for `BTreeLeafLayout::ArrayOfPairs`.
+		 *
+		 * All leaf layouts expose the same accessors so the tree algorithms
+		 * never touch the underlying arrays directly. With an abbreviation policy,
+		 * `abbrevs` holds the abbreviation of every key at the same index.
+		 */
+		struct PairLeafNode : LeafLinks
+		{
+			BTreeInlineVector<std::pair<Key, Value>, s_LEAF_MAX_KEYS + 1> entries;
+			[[no_unique_address]] LeafAbbrevs abbrevs;
+
+			size_t size() const { return entries.size(); }
+			bool empty() const { return entries.empty(); }
+			Key& key(size_t i) { return entries[i].first; }
+			const Key& key(size_t i) const { return entries[i].first; }
+			Value& value(size_t i) { return entries[i].second; }
+			const Value& value(size_t i) const { return entries[i].second; }
+
+			template <typename K, typename V>
+			void insert(size_t i, K &&k, V &&v)
+			{
+				entries.emplace(entries.begin() + i, std::forward<K>(k), std::forward<V>(v));
+
+				if constexpr (s_ABBREVIATED) {
+					abbrevs.insert(abbrevs.begin() + i, Abbreviation::abbreviate(entries[i].first));
+				}
+			}
+
+			void erase(size_t i)
+			{
+				entries.erase(entries.begin() + i);
+
+				if constexpr (s_ABBREVIATED) {
+					abbrevs.erase(abbrevs.begin() + i);
+				}
+			}
+
+			/**
+			 * Moves the entries [from, size()) to the end of `dst` and drops them from this leaf.
+			 */
+			void moveTail(size_t from, PairLeafNode &dst)
+			{
+				dst.entries.insert(
+					dst.entries.end(),
+					std::make_move_iterator(entries.begin() + from),
+					std::make_move_iterator(entries.end())
+				);
+
+				entries.erase(entries.begin() + from, entries.end());
+
+				if constexpr (s_ABBREVIATED) {
+					dst.abbrevs.insert(dst.abbrevs.end(), abbrevs.begin() + from, abbrevs.end());
+					abbrevs.erase(abbrevs.begin() + from, abbrevs.end());
+				}
+			}
+		};
+
+		/**
+		 * @brief Leaf storage for `BTreeLeafLayout::SplitKeysValues`.
+		 *
+		 * Keys and values live in parallel arrays, so a lookup walks a dense array
+		 * of keys and only touches the values array on a hit.
+		 */
+		struct SplitLeafNode : LeafLinks
+		{
+			BTreeInlineVector<Key, s_LEAF_MAX_KEYS + 1> keys;
+			BTreeInlineVector<Value, s_LEAF_MAX_KEYS + 1> values;
+			[[no_unique_address]] LeafAbbrevs abbrevs;
+
+			size_t size() const { return keys.size(); }
+			bool empty() const { return keys.empty(); }
+			Key& key(size_t i) { return keys[i]; }
+			const Key& key(size_t i) const { return keys[i]; }
+			Value& value(size_t i) { return values[i]; }
+			const Value& value(size_t i) const { return values[i]; }
+
+			template <typename K, typename V>
+			void insert(size_t i, K &&k, V &&v)
+			{
+				keys.emplace(keys.begin() + i, std::forward<K>(k));
+				values.emplace(values.begin() + i, std::forward<V>(v));
+
+				if constexpr (s_ABBREVIATED) {
+					abbrevs.insert(abbrevs.begin() + i, Abbreviation::abbreviate(keys[i]));
+				}
+			}
+
+			void erase(size_t i)
+			{
+				keys.erase(keys.begin() + i);
+				values.erase(values.begin() + i);
+
+				if constexpr (s_ABBREVIATED) {
+					abbrevs.erase(abbrevs.begin() + i);
+				}
+			}
+
+			/**
+			 * Moves the entries [from, size()) to the end of `dst` and drops them from this leaf.
+			 */
+			void moveTail(size_t from, SplitLeafNode &dst)
+			{
+				dst.keys.insert(
+					dst.keys.end(),
+					std::make_move_iterator(keys.begin() + from),
+					std::make_move_iterator(keys.end())
+				);
+				dst.values.insert(
+					dst.values.end(),
+					std::make_move_iterator(values.begin() + from),
+					std::make_move_iterator(values.end())
+				);
+
+				keys.erase(keys.begin() + from, keys.end());
+				values.erase(values.begin() + from, values.end());
+
+				if constexpr (s_ABBREVIATED) {
+					dst.abbrevs.insert(dst.abbrevs.end(), abbrevs.begin() + from, abbrevs.end());
+					abbrevs.erase(abbrevs.begin() + from, abbrevs.end());
+				}
+			}
+		};
+
+		/**
+		 * @brief Leaf storage for `BTreeLeafLayout::PrefixCompressed`.
+		 *
+		 * `bytes` holds `prefix()`, common to every key of the leaf (not necessarily the
+		 * longest such prefix), followed by the rest of every key back to back: `suffix(i)`
+		 * ends `ends[i]` bytes past the prefix. Up to `s_PREFIX_LEAF_BYTES` of them live in
+		 * the node itself. `key(i)` returns a rebuilt copy instead of a reference.
+		 */
+		struct PrefixLeafNode : LeafLinks
+		{
+			boost::container::small_vector<char, s_PREFIX_LEAF_BYTES> bytes;
+			uint32_t prefixLength = 0;
+			BTreeInlineVector<uint32_t, s_LEAF_MAX_KEYS + 1> ends;
+			BTreeInlineVector<Value, s_LEAF_MAX_KEYS + 1> values;
+
+			size_t size() const { return values.size(); }
+			bool empty() const { return values.empty(); }
+			Value& value(size_t i) { return values[i]; }
+			const Value& value(size_t i) const { return values[i]; }
+
+			std::string_view prefix() const { return std::string_view(bytes.data(), prefixLength); }
+
+			size_t suffixBegin(size_t i) const { return i ? ends[i - 1] : 0; }
+
+			std::string_view suffix(size_t i) const
+			{
+				return std::string_view(bytes.data() + prefixLength + suffixBegin(i), ends[i] - suffixBegin(i));
+			}
+
+			Key key(size_t i) const
+			{
+				std::string_view rest = suffix(i);
+				Key k;
+
+				k.reserve(prefixLength + rest.size());
+				k.append(prefix()).append(rest);
+
+				return k;
+			}
+
+			/**
+			 * True if key i equals `k`, without rebuilding key i.
+			 */
+			bool holds(size_t i, std::string_view k) const
+			{
+				return k.size() == prefixLength + ends[i] - suffixBegin(i)
+					&& k.starts_with(prefix())
+					&& k.substr(prefixLength) == suffix(i);
+			}
+
+			/**
+			 * Index of the first key not less than `k`: one comparison against the prefix,
+			 * then a binary search over the suffixes.
+			 */
+			size_t lowerBound(std::string_view k) const
+			{
+				int head = k.substr(0, prefixLength).compare(prefix());
+
+				if (head != 0) {
+					return head < 0 ? 0 : size();
+				}
+
+				std::string_view rest = k.substr(prefixLength);
+				size_t low = 0;
+				size_t high = size();
+
+				while (low < high) {
+					size_t mid = (low + high) / 2;
+
+					if (suffix(mid) < rest) {
+						low = mid + 1;
+					} else {
+						high = mid;
+					}
+				}
+
+				return low;
+			}
+
+			template <typename K, typename V>
+			void insert(size_t i, K &&k, V &&v)
+			{
+				std::string_view full = k;
+
+				if (empty()) {
+					bytes.assign(full.begin(), full.end());
+					prefixLength = static_cast<uint32_t>(full.size());
+					ends.clear();
+				} else if (!full.starts_with(prefix())) {
+					std::string_view current = prefix();
+					auto shared = std::mismatch(current.begin(), current.end(), full.begin(), full.end()).first;
+
+					narrowPrefix(shared - current.begin());
+				}
+
+				std::string_view rest = full.substr(prefixLength);
+				size_t at = suffixBegin(i);
+
+				bytes.insert(bytes.begin() + prefixLength + at, rest.begin(), rest.end());
+				ends.insert(ends.begin() + i, static_cast<uint32_t>(at));
+
+				for (size_t j = i; j < ends.size(); ++j) {
+					ends[j] += rest.size();
+				}
+
+				values.emplace(values.begin() + i, std::forward<V>(v));
+			}
+
+			void erase(size_t i)
+			{
+				size_t at = suffixBegin(i);
+				size_t length = ends[i] - at;
+
+				bytes.erase(bytes.begin() + prefixLength + at, bytes.begin() + prefixLength + at + length);
+				ends.erase(ends.begin() + i);
+
+				for (size_t j = i; j < ends.size(); ++j) {
+					ends[j] -= length;
+				}
+
+				values.erase(values.begin() + i);
+			}
+
+			/**
+			 * Moves the entries [from, size()) to the end of `dst` and drops them from this leaf.
+			 * The keys of `dst` must sort before the moved ones. Both leaves then take the
+			 * longest prefix their remaining keys share.
+			 */
+			void moveTail(size_t from, PrefixLeafNode &dst)
+			{
+				if (from == size()) {
+					return;
+				}
+
+				std::string_view current = prefix();
+
+				if (dst.empty()) {
+					dst.bytes.assign(current.begin(), current.end());
+					dst.prefixLength = prefixLength;
+					dst.ends.clear();
+				} else {
+					std::string_view other = dst.prefix();
+					auto shared = std::mismatch(other.begin(), other.end(), current.begin(), current.end()).first;
+
+					dst.narrowPrefix(shared - other.begin());
+				}
+
+				std::string_view extra = current.substr(dst.prefixLength);
+
+				for (size_t i = from; i < size(); ++i) {
+					std::string_view rest = suffix(i);
+
+					dst.bytes.insert(dst.bytes.end(), extra.begin(), extra.end());
+					dst.bytes.insert(dst.bytes.end(), rest.begin(), rest.end());
+					dst.ends.push_back(static_cast<uint32_t>(dst.bytes.size() - dst.prefixLength));
+				}
+
+				dst.values.insert(
+					dst.values.end(),
+					std::make_move_iterator(values.begin() + from),
+					std::make_move_iterator(values.end())
+				);
+
+				bytes.resize(prefixLength + suffixBegin(from));
+				ends.erase(ends.begin() + from, ends.end());
+				values.erase(values.begin() + from, values.end());
+
+				widenPrefix();
+				dst.widenPrefix();
+			}
+
+			/**
+			 * Shortens the prefix to `length` bytes, prepending the rest of it to every suffix.
+			 */
+			void narrowPrefix(size_t length)
+			{
+				std::string_view extra = prefix().substr(length);
+				boost::container::small_vector<char, s_PREFIX_LEAF_BYTES> rebuilt;
+
+				rebuilt.reserve(bytes.size() + extra.size() * size());
+				rebuilt.insert(rebuilt.end(), bytes.begin(), bytes.begin() + length);
+
+				for (size_t i = 0, begin = 0; i < size(); ++i) {
+					size_t end = ends[i];
+					const char* rest = bytes.data() + prefixLength;
+
+					rebuilt.insert(rebuilt.end(), extra.begin(), extra.end());
+					rebuilt.insert(rebuilt.end(), rest + begin, rest + end);
+					ends[i] = static_cast<uint32_t>(rebuilt.size() - length);
+					begin = end;
+				}
+
+				bytes = std::move(rebuilt);
+				prefixLength = static_cast<uint32_t>(length);
+			}
+
+			/**
+			 * Moves the bytes all suffixes start with into the prefix. The keys are sorted,
+			 * so those are the bytes the first and the last suffix share. The first suffix
+			 * directly follows the prefix, so only the later suffixes shift down.
+			 */
+			void widenPrefix()
+			{
+				if (empty()) {
+					return;
+				}
+
+				std::string_view first = suffix(0);
+				std::string_view last = suffix(size() - 1);
+				size_t length = std::mismatch(first.begin(), first.end(), last.begin(), last.end()).first - first.begin();
+
+				if (length == 0) {
+					return;
+				}
+
+				char* rest = bytes.data() + prefixLength;
+				size_t write = ends[0];
+
+				ends[0] -= static_cast<uint32_t>(length);
+
+				for (size_t i = 1, begin = write; i < size(); ++i) {
+					size_t end = ends[i];
+
+					std::copy(rest + begin + length, rest + end, rest + write);
+					write += end - begin - length;
+					ends[i] = static_cast<uint32_t>(write - length);
+					begin = end;
+				}
+
+				bytes.resize(prefixLength + write);
+				prefixLength += static_cast<uint32_t>(length);
+			}
+		};
+
+		using LeafNode = std::conditional_t<s_PREFIX_LEAVES, PrefixLeafNode,
+			std::conditional_t<s_SPLIT_LEAVES, SplitLeafNode, PairLeafNode>>;
+
+		/**
+		 * @struct Node
+		 * @brief Header shared by the two kinds of nodes in the B-Tree.
+		 *
+		 * A leaf holds up to `BTree::s_LEAF_MAX_KEYS` entries and an internal node up to
+		 * `BTree::s_INTERNAL_MAX_KEYS` separator keys. Each kind is allocated as a
+		 * `SizedNode` of exactly its own size; `leaf()` and `internal()` reach the body
+		 * following the header, so a node's first cache line holds the header together
+		 * with the key count and the first keys.
+		 */
+		struct Node
+		{
+			bool isLeaf;
+
+			/**
+			 * @brief The handle other nodes link to this one through, with `compactHandles`.
+			*/
+			[[no_unique_address]] std::conditional_t<s_COMPACT_HANDLES, uint32_t, NoSummary> handle;
+
+			/**
+			 * @brief Constructs the header of a node.
+			 *
+			 * @param leaf  If true, this node will act as a leaf; otherwise as an internal node.
+			*/
+			explicit Node(bool leaf);
+
+			LeafNode& leaf() { return static_cast<SizedNode<LeafNode>*>(this)->body; }
+			const LeafNode& leaf() const { return static_cast<const SizedNode<LeafNode>*>(this)->body; }
+			InternalNode& internal() { return static_cast<SizedNode<InternalNode>*>(this)->body; }
+			const InternalNode& internal() const { return static_cast<const SizedNode<InternalNode>*>(this)->body; }
+		};
+
+		/**
+		 * @brief A node as allocated: the header followed by the body of its kind.
+		*/
+		template <typename Body>
+		struct SizedNode : Node
+		{
+			Body body;
+
+			SizedNode() : Node(std::is_same_v<Body, LeafNode>), body() {}
+		};
+
+		/**
+		 * @brief Bytes taken by a leaf node.
+		*/
+		static constexpr size_t s_LEAF_NODE_BYTES = sizeof(SizedNode<LeafNode>);
+
+		/**
+		 * @brief Bytes taken by an internal node.
+		*/
+		static constexpr size_t s_INTERNAL_NODE_BYTES = sizeof(SizedNode<InternalNode>);
+
+		/**
+		 * @brief Accesses the value associated with a key. This does a search behind the scenes
+		 * 	so don't use it for repeated access, instead loop over the iterator and do your custom
+		 * 	logic there.
+		 *
+		 * If the key exists, returns a reference to its value. Otherwise,
+		 * an out of range exception will be thrown
+		 *
+		 * @param key  The key to locate or insert.
+		 * @return Reference to the mapped value.
+		*/
+		Value& operator[](const Key& key);
+
+		/**
+		 * @brief Returns the number of key/value pairs stored in the tree.
+		 *
+		 * This size of the B+Tree is updated during insertions and deletions and thus not computed.
+		 *
+		 * @return The number of entries in the tree.
+		*/
+		size_t size() const;
+
+		/**
+		 * @brief Inserts a key/value pair into the tree.
+		 *
+		 * If the key does not already exist, a new node is created.
+		 * If the key exists, the insertion is skipped.
+		 *
+		 * A key greater than every key in the tree is appended to the rightmost leaf without
+		 * descending from the root, and the leaf is split right-biased, so strictly increasing
+		 * inserts fill the leaves completely instead of leaving them half empty.
+		 *
+		 * @param key     The key to insert.
+		 * @param value   The value to associate with the key.
+		 * @return true if the pair was inserted; false if the key was already present.
+		*/
+		bool insert(const Key &key, const Value &value);
+
+		/**
+		 * @brief Inserts a batch of key/value pairs with one pass over the affected leaves.
+		 *
+		 * The batch is sorted first (LSD radix sort for integral keys with the natural
+		 * ordering, a stable comparison sort otherwise). The tree is then walked once in
+		 * key order: each leaf is reached by climbing only as far up the current path as
+		 * the next key requires, and the whole run of keys that belongs to it is merged in
+		 * with a single shift of its tail. A leaf that overflows is split into as many
+		 * leaves as needed at once, and the new separators go into the parent together,
+		 * which is split the same way if it overflows in turn.
+		 *
+		 * Keys already in the tree get the batch's value, like `insert`. When the batch
+		 * holds the same key several times, the pair that comes last in the batch wins.
+		 *
+		 * @param batch  The pairs to insert, in any order.
+		 * @return The number of keys that were not in the tree before.
+		*/
+		size_t insertBatch(std::span<const std::pair<Key, Value>> batch);
+
+		/**
+		 * @brief Searches for the value associated with a given key.
 		 *
 		 * Traverses the tree to locate the node matching key.
 		 *
 		 * @param key   The key to look up.
 		 * @return Pointer to the stored value if found; nullptr if the key is not in the tree.
 		*/
-		Value* search(const Key &key) const;
+		Value* search(const Key &key) const;
+
+		/**
+		 * @brief Looks up many keys at once, overlapping the cache misses of their descents.
+		 *
+		 * Keys are processed in groups of `s_BATCH_GROUP`. Every lookup of a group
+		 * advances one level at a time, and the child each one moves to is prefetched
+		 * before the next lookup of the group touches its own node, so the memory
+		 * latency of independent descents overlaps instead of adding up.
+		 *
+		 * @param keys  The keys to look up.
+		 * @param out   Receives, at the same index as each key, a pointer to its value
+		 *              or nullptr when the key is not in the tree. Must be at least as
+		 *              long as `keys`.
+		*/
+		void searchBatch(std::span<const Key> keys, std::span<Value*> out) const;
+
+		/**
+		 * @brief Removes the entry with the specified key.
+		 *
+		 * Descends once to the leaf holding `key` and erases the entry. Only if the leaf
+		 * underflows (see `BTreeUnderflowPolicy`) is it fixed up, and the fix-up climbs the
+		 * descent path only as far as parents keep underflowing. A missing key leaves the
+		 * tree untouched.
+		 *
+		 * @param key   The key of the entry to remove.
+		 * @return true if an element was removed; false if the key was not found.
+		*/
+		bool remove(const Key &key);
+
+		/**
+		 * @brief Removes every entry whose key is within [low, high], inclusive.
+		 *
+		 * Cuts the tree along the two boundary paths instead of removing key by key:
+		 * subtrees fully inside the interval are detached whole and their nodes handed
+		 * back to the pool, and the two remaining halves are joined along the seam. Costs
+		 * O(log n) plus one release per dropped node.
+		 *
+		 * @param low   The lower bound key (inclusive).
+		 * @param high  The upper bound key (inclusive).
+		 * @return The number of entries removed; 0 if `high < low`.
+		*/
+		size_t eraseRange(const Key &low, const Key &high);
+
+		/**
+		 * @brief Moves every entry whose key is >= `key` into a new tree.
+		 *
+		 * The tree is cut along the descent path of `key` and the leaf chain is cut at the
+		 * seam. No entry is copied: both trees keep their nodes in the same `NodePool`,
+		 * which stays alive until the last of them is destroyed. A pending `compact` pass
+		 * is finished first.
+		 *
+		 * With `Traits::orderStatistics` the size of the new tree comes from `rank` and the
+		 * whole split costs O(log n). Without it the shorter side of the cut is counted leaf
+		 * by leaf, which adds O(min(k, n - k) / LeafCapacity) for k entries below `key`.
+		 *
+		 * @warning The shared pool is not synchronized: its free lists and counters change
+		 * 	on every insert and remove of either tree. The two trees must stay on one thread
+		 * 	(or behind one lock) until each has a pool of its own. Call `compact()` on one of
+		 * 	them, still on that thread, to copy it into a private pool before handing it to
+		 * 	another thread; `join` merges them back into one.
+		 *
+		 * @param key  The first key that goes to the new tree; it does not have to be in the tree.
+		 * @return The tree holding the keys >= `key`; this tree keeps the keys below it.
+		*/
+		BTree split(const Key &key);
+
+		/**
+		 * @brief Moves all entries of `other` into this tree, in O(log n).
+		 *
+		 * The key ranges must not overlap; `other` may sort before or after this tree.
+		 * The shorter tree is grafted onto the spine of the taller one and the leaf chains
+		 * are linked at the seam. When `other` has a pool of its own its blocks are handed
+		 * over to this tree's pool; when it shares one with a third tree its nodes are
+		 * copied over instead, in O(n). A pending `compact` pass of either tree is finished
+		 * first.
+		 *
+		 * @param other  The tree to take the entries from; it is left empty.
+		 * @throws std::invalid_argument if the key ranges overlap.
+		*/
+		void join(BTree &&other);
+
+		/**
+		 * @brief Moves all entries of `other` into this tree; the key ranges may overlap.
+		 *
+		 * Both leaf chains are walked together in key order and the merged entries are
+		 * moved into full leaves, with the internal levels built bottom-up as in
+		 * `bulkLoad`: O(n + m) with sequential access on both sides. When the smaller tree
+		 * holds at most 1/`s_LEAF_MAX_KEYS` of the entries of the larger one, its entries
+		 * go into the larger tree in place instead, through `insertBatch`.
+		 *
+		 * @param other   The tree to take the entries from; it is left empty.
+		 * @param policy  Which value survives when a key is in both trees.
+		*/
+		void mergeFrom(BTree &&other, BTreeConflictPolicy policy = BTreeConflictPolicy::KeepLeft);
+
+		/**
+		 * @brief Like `mergeFrom(other, policy)`, but a key present in both trees gets
+		 *        `combine(leftValue, rightValue)`, the left value being this tree's.
+		 *
+		 * If `combine` throws, the exception propagates and both trees are left valid
+		 * but with unspecified contents.
+		 *
+		 * @param other    The tree to take the entries from; it is left empty.
+		 * @param combine  Callable `Value(const Value &left, const Value &right)`.
+		*/
+		template <typename Combine>
+		void mergeFrom(BTree &&other, Combine combine);
+
+		/**
+		 * @brief Reports every entry of this tree whose key is also in `other`.
+		 *
+		 * The set operators walk both leaf chains together in key order. A side that
+		 * falls behind without reporting its entries catches up in one step: within the
+		 * current leaf by a binary search, or, once it trails by more than the next leaf,
+		 * by a fresh descent from the root. Sparse overlaps therefore cost O(k log n)
+		 * instead of O(n + m).
+		 *
+		 * @param other     The tree to intersect with.
+		 * @param callback  Called as `callback(key, value)` in ascending key order.
+		 * @return The number of entries reported.
+		*/
+		template <typename Callback>
+		size_t intersect(const BTree &other, Callback callback) const;
+
+		/**
+		 * @brief Reports every entry of this tree whose key is not in `other`.
+		 *
+		 * @param other     The tree whose keys are left out.
+		 * @param callback  Called as `callback(key, value)` in ascending key order.
+		 * @return The number of entries reported.
+		*/
+		template <typename Callback>
+		size_t difference(const BTree &other, Callback callback) const;
+
+		/**
+		 * @brief Reports every entry whose key is in exactly one of the two trees.
+		 *
+		 * @param other     The tree to compare with.
+		 * @param callback  Called as `callback(key, value)` in ascending key order, with
+		 *                  the value of whichever tree holds the key.
+		 * @return The number of entries reported.
+		*/
+		template <typename Callback>
+		size_t symmetricDifference(const BTree &other, Callback callback) const;
+
+		/**
+		 * @brief Sort-merge inner join: reports the values of both trees for every
+		 *        key they have in common.
+		 *
+		 * @param other     The right-hand side of the join.
+		 * @param callback  Called as `callback(key, leftValue, rightValue)` in ascending
+		 *                  key order, `leftValue` being this tree's.
+		 * @return The number of keys reported.
+		*/
+		template <typename Callback>
+		size_t join(const BTree &other, Callback callback) const;
+
+		/**
+		 * @brief The result of `range` and `rangeReverse` with prefix-compressed leaves, which
+		 * 	hold no key objects to point to: the keys are rebuilt into `keys` and the entries
+		 * 	point there. Moving the result keeps the pointers valid; copying it is not allowed.
+		*/
+		struct MaterializedRange
+		{
+			std::deque<Key> keys;
+			std::vector<std::pair<const Key*, Value*>> entries;
+
+			MaterializedRange() = default;
+			MaterializedRange(MaterializedRange &&) = default;
+			MaterializedRange& operator=(MaterializedRange &&) = default;
+			MaterializedRange(const MaterializedRange &) = delete;
+			MaterializedRange& operator=(const MaterializedRange &) = delete;
+
+			void reserve(size_t count) { entries.reserve(count); }
+
+			void emplace_back(Key key, Value* value)
+			{
+				keys.push_back(std::move(key));
+				entries.emplace_back(&keys.back(), value);
+			}
+
+			size_t size() const { return entries.size(); }
+			bool empty() const { return entries.empty(); }
+			const std::pair<const Key*, Value*>& operator[](size_t i) const { return entries[i]; }
+			auto begin() const { return entries.begin(); }
+			auto end() const { return entries.end(); }
+		};
+
+		/**
+		 * @brief (key pointer, value pointer) pairs collected by `range` and `rangeReverse`.
+		*/
+		using RangeEntries = std::conditional_t<s_PREFIX_LEAVES, MaterializedRange, std::vector<std::pair<const Key*, Value*>>>;
+
+		/**
+		 * @brief Collects all entries whose keys are within [low, high], inclusive.
+		 *
+		 * Performs an in-order traversal to gather matching entries in ascending key order.
+		 *
+		 * @param low   The lower bound key (inclusive).
+		 * @param high  The upper bound key (inclusive).
+		 * @return A vector of (key pointer, value pointer) pairs for matching entries.
+		*/
+		RangeEntries range(const Key &low, const Key &high);
+
+		/**
+		 * @brief Collects up to `count` entries starting at key ≥ low.
+		 *
+		 * Traverses the tree in order beginning at the first entry ≥ low,
+		 * gathering at most `count` results.
+		 *
+		 * @param low    The starting key (inclusive).
+		 * @param count  Maximum number of entries to return.
+		 * @return A vector of (key pointer, value pointer) pairs for the first `count` entries ≥ low.
+		*/
+		RangeEntries range(const Key &low, size_t count);
+
+		/**
+		 * @brief Returns a lazy view over the entries whose keys are within [low, high], inclusive.
+		 *
+		 * Nothing is collected up front: the view holds two iterators (one descent each)
+		 * and walks the leaf chain as it is consumed, so it composes with
+		 * `std::views::filter`, `std::views::take` etc. and stopping early costs nothing.
+		 * Elements are `std::pair<const Key&, Value&>`. Modifying the tree invalidates the view.
+		 *
+		 * @param low   The lower bound key (inclusive).
+		 * @param high  The upper bound key (inclusive).
+		 * @return A `std::ranges::view` of the matching entries in ascending key order.
+		*/
+		auto rangeView(const Key &low, const Key &high);
+
+		/**
+		 * @brief Returns a lazy view over at most `count` entries starting at key ≥ low.
+		 *
+		 * Like `rangeView(low, high)`, the leaf chain is walked on demand.
+		 *
+		 * @param low    The starting key (inclusive).
+		 * @param count  Maximum number of entries in the view.
+		 * @return A `std::ranges::view` of the first `count` entries ≥ low.
+		*/
+		auto rangeView(const Key &low, size_t count);
 
 		/**
-		 * @brief Removes the entry with the specified key.
+		 * @brief Collects up to `count` entries with key ≤ high, in descending key order.
 		 *
-		 * Finds the node matching key, removes it, and rebalances the tree.
+		 * Descends once to the leaf containing `high` and walks the `prevLeaf` chain
+		 * backwards, e.g. to fetch the latest N events before a timestamp.
 		 *
-		 * @param key   The key of the entry to remove.
-		 * @return true if an element was removed; false if the key was not found.
+		 * @param high   The starting key (inclusive).
+		 * @param count  Maximum number of entries to return.
+		 * @return A vector of (key pointer, value pointer) pairs for the last `count` entries ≤ high.
 		*/
-		bool remove(const Key &key);
+		RangeEntries rangeReverse(const Key &high, size_t count);
 
 		/**
-		 * @brief Collects all entries whose keys are within [low, high], inclusive.
+		 * @brief Returns a lazy view over the entries whose keys are within [low, high],
+		 * 	in descending key order.
 		 *
-		 * Performs an in-order traversal to gather matching entries in ascending key order.
+		 * The mirror image of `rangeView(low, high)`: the view starts at `high` and walks the
+		 * `prevLeaf` chain on demand.
 		 *
 		 * @param low   The lower bound key (inclusive).
 		 * @param high  The upper bound key (inclusive).
-		 * @return A vector of (key pointer, value pointer) pairs for matching entries.
+		 * @return A `std::ranges::view` of the matching entries, largest key first.
 		*/
-		std::vector<std::pair<const Key*, Value*>> range(const Key &low, const Key &high);
+		auto rangeViewReverse(const Key &low, const Key &high);
 
 		/**
-		 * @brief Collects up to `count` entries starting at key ≥ low.
+		 * @brief Returns a lazy view over at most `count` entries with key ≤ high,
+		 * 	in descending key order.
 		 *
-		 * Traverses the tree in order beginning at the first entry ≥ low,
-		 * gathering at most `count` results.
-		 *
-		 * @param low    The starting key (inclusive).
-		 * @param count  Maximum number of entries to return.
-		 * @return A vector of (key pointer, value pointer) pairs for the first `count` entries ≥ low.
+		 * @param high   The starting key (inclusive).
+		 * @param count  Maximum number of entries in the view.
+		 * @return A `std::ranges::view` of the last `count` entries ≤ high, largest key first.
 		*/
-		std::vector<std::pair<const Key*, Value*>> range(const Key &low, size_t count);
+		auto rangeViewReverse(const Key &high, size_t count);
 
 		/**
 		 * @brief Moves a value from a key to another.
@@ -295,6 +1690,31 @@ class BTree
 		*/
 		bool move(const Key &from, const Key &to);
 
+		/**
+		 * @brief Replaces the contents of the tree with a range sorted by key, in O(n).
+		 *
+		 * Packs the entries straight into leaves taken from the node pool, stitches the
+		 * `nextLeaf`/`prevLeaf` chain as it goes, then builds each internal level from
+		 * the one below it. No descent, split or shift happens per entry.
+		 *
+		 * Leaves get `fillFactor * s_LEAF_MAX_KEYS` entries and internal nodes
+		 * `fillFactor * s_MAX_CHILDREN` children (never fewer than the minimums), so a
+		 * factor below 1 leaves room for later inserts without immediate splits.
+		 * The last two nodes of a level are evened out so neither ends up underfull.
+		 *
+		 * Consecutive equal keys are collapsed like repeated `insert` calls would:
+		 * one entry is kept and it holds the last value.
+		 *
+		 * @param first       Iterator to the first (key, value) pair; anything with
+		 *                    `first`/`second` members or structured bindings works.
+		 * @param last        Iterator one past the last pair.
+		 * @param fillFactor  Fraction of each node's capacity to fill, in (0, 1].
+		 * @throws std::invalid_argument if the range is not sorted by key, in which
+		 *         case the tree is left unchanged.
+		*/
+		template <typename InputIt>
+		void bulkLoad(InputIt first, InputIt last, double fillFactor = 1.0);
+
 #ifdef BTREE_ENABLE_JSON
 		std::string serializeToJson() const;
 #else
@@ -304,10 +1724,12 @@ class BTree
 		{
 			public:
 				using difference_type = std::ptrdiff_t;
+				using value_type = std::pair<KeyReference, Value&>;
+				using reference = value_type;
 				using iterator_category = std::bidirectional_iterator_tag;
 
 				Iterator() noexcept;
-				std::pair<const Key&, Value&> operator*() const;
+				std::pair<KeyReference, Value&> operator*() const;
 				Iterator& operator++ ();
 				Iterator operator++ (int);
 				Iterator& operator-- ();
@@ -320,76 +1742,595 @@ class BTree
 				Node* m_CurrentNode;
 				size_t m_CurrentIndex;
 
-				Iterator(BTree *tree, Node *node, size_t index) noexcept;
+				Iterator(BTree *tree, Node *node, size_t index) noexcept;
+
+			friend class BTree;
+		};
+
+		/**
+		 * @brief Returns an iterator to the first (smallest) element.
+		 *
+		 * Starts a forward in-order traversal of the B+Tree,
+		 * yielding entries from low keys to high.
+		 *
+		 * @return Iterator pointing at the minimum key.
+		 */
+		Iterator begin();
+
+		/**
+		 * @brief Returns an iterator one past the last element.
+		 *
+		 * @return End iterator.
+		*/
+		Iterator end() noexcept;
+
+		/**
+		 * @brief Returns an iterator to the first element whose key is not less than `key`.
+		 *
+		 * Descends once to the leaf that would hold `key`; incrementing the iterator
+		 * continues along the leaf chain without further descents or allocations.
+		 *
+		 * @param key  The key to position at.
+		 * @return Iterator at the first key ≥ `key`, or `end()` if there is none.
+		*/
+		Iterator lower_bound(const Key &key);
+
+		/**
+		 * @brief Returns an iterator to the first element whose key is greater than `key`.
+		 *
+		 * @param key  The key to position after.
+		 * @return Iterator at the first key > `key`, or `end()` if there is none.
+		*/
+		Iterator upper_bound(const Key &key);
+
+		/**
+		 * @brief Returns an iterator to the element stored under `key`.
+		 *
+		 * @param key  The key to look for.
+		 * @return Iterator at the entry, or `end()` if the key is not in the tree.
+		*/
+		Iterator find(const Key &key);
+
+		/**
+		 * @brief Returns the range of elements whose key is equivalent to `key`.
+		 *
+		 * Keys are unique, so the range holds one element or is empty (both iterators
+		 * at `lower_bound(key)`).
+		 *
+		 * @param key  The key to look for.
+		 * @return The pair (`lower_bound(key)`, `upper_bound(key)`).
+		*/
+		std::pair<Iterator, Iterator> equal_range(const Key &key);
+
+		/**
+		 * @brief Returns the number of keys less than `key`, in O(log n).
+		 *
+		 * Requires `Traits::orderStatistics`.
+		 *
+		 * @param key  The key to rank; it does not have to be in the tree.
+		 * @return The zero-based position `key` has (or would have) in key order.
+		*/
+		size_t rank(const Key &key) const;
+
+		/**
+		 * @brief Returns an iterator to the element at zero-based position `k` in key order,
+		 * 	in O(log n).
+		 *
+		 * Requires `Traits::orderStatistics`. Useful for pagination by offset and
+		 * percentile lookups; incrementing the iterator continues along the leaf chain.
+		 *
+		 * @param k  Position of the element.
+		 * @return Iterator at the k-th smallest key, or `end()` if `k >= size()`.
+		*/
+		Iterator select(size_t k);
+
+		/**
+		 * @brief Returns the number of keys within [low, high], inclusive, in O(log n).
+		 *
+		 * Requires `Traits::orderStatistics`.
+		 *
+		 * @param low   The lower bound key (inclusive).
+		 * @param high  The upper bound key (inclusive).
+		 * @return The number of entries in the interval; 0 if `high < low`.
+		*/
+		size_t count(const Key &low, const Key &high) const;
+
+		/**
+		 * @brief Combines the entries within [low, high], inclusive, in key order, in O(log n).
+		 *
+		 * Requires `Traits::Aggregate`. Whole subtrees inside the interval contribute their
+		 * stored aggregate, so only the two boundary paths are visited. Values changed in
+		 * place through `search` or an iterator are not seen by the stored aggregates;
+		 * update them with `insert` instead.
+		 *
+		 * @param low   The lower bound key (inclusive).
+		 * @param high  The upper bound key (inclusive).
+		 * @return The aggregate of the interval; `Aggregate::identity()` if it is empty.
+		*/
+		AggregateValue aggregate(const Key &low, const Key &high) const;
+
+		/**
+		 * @brief Returns a reverse iterator to the last (largest) element.
+		 *
+		 * Starts a reverse in-order traversal of the B+Tree,
+		 * yielding entries from high keys down to low.
+		 *
+		 * @return A std::reverse_iterator over Iterator, initially pointing at the maximum key.
+		*/
+		std::reverse_iterator<Iterator> rbegin();
+
+		/**
+		 * @brief Returns a reverse iterator one past the first (smallest) element.
+		 *
+		 * This marks the end of a reverse in-order traversal.
+		 *
+		 * @return A std::reverse_iterator over Iterator at the rend position.
+		 */
+		std::reverse_iterator<Iterator> rend() noexcept;
+
+		/**
+		 * Slot accounting of the node pool.
+		 */
+		struct PoolStats
+		{
+			/**
+			 * Slots holding a node of the tree.
+			 */
+			size_t liveNodes;
+			/**
+			 * Released slots waiting on a free list.
+			 */
+			size_t freeNodes;
+			/**
+			 * Slots carved out of the pool blocks so far (live + free).
+			 */
+			size_t usedNodes;
+			/**
+			 * Total slot capacity of all allocated blocks.
+			 */
+			size_t capacityNodes;
+			size_t blocks;
+			/**
+			 * Bytes taken by the live nodes, each kind counted at its own size.
+			 */
+			size_t liveBytes;
+		};
+
+		/**
+		 * @brief Reports how many node slots are live, sitting on a free list, or still unused.
+		 *
+		 * Under steady insert/remove churn usedNodes should plateau: freed slots are reused
+		 * before the pool grows. Trees cut apart with `split` share one pool and report it
+		 * as a whole.
+		 *
+		 * @return PoolStats
+		 */
+		PoolStats poolStats() const;
+
+		/**
+		 * @brief Relocates every node into fresh pool blocks so that internal nodes sit in
+		 * 	breadth-first order followed by the leaves in key order, then releases the old blocks.
+		 *
+		 * The pass can be spread over several calls: with a non-zero `maxNodes` each call visits
+		 * at most that many nodes and remembers where it stopped, so inserts and removes may run
+		 * in between. Nodes created meanwhile are allocated in the fresh blocks; nodes released
+		 * from the old blocks are not recycled. Relocation invalidates iterators and value pointers.
+		 *
+		 * A tree that shares its pool with others after a `split` cannot empty the shared
+		 * blocks; it is moved into a pool of its own in a single pass instead.
+		 *
+		 * @param maxNodes  Upper bound on the nodes visited by this call; 0 finishes the pass.
+		 * @return true if compaction is complete and the old blocks were released.
+		 */
+		bool compact(size_t maxNodes = 0);
+
+		/**
+		 * @brief Destroys the B-Tree, freeing all internal nodes.
+		 *
+		*/
+		~BTree();
+
+	private:
+		Node* m_Root;
+
+		/**
+		 * The rightmost leaf, kept current by every operation that adds, frees or moves
+		 * leaves. Keys greater than its last key are appended without a descent.
+		 */
+		Node* m_LastLeaf;
+		Compare m_Comp;
+		size_t m_Size{0};
+		static constexpr size_t s_BLOCK_NODES = 1024;
+		static constexpr size_t s_SIZE_CLASSES = 2;
+
+		/**
+		 * Alignment of every slot. A released slot holds a `NodePool::FreeSlot`, whose link
+		 * is a pointer, so slots of nodes that only need 4 bytes (`compactHandles`) are
+		 * padded to the pointer's alignment as well.
+		 */
+		static constexpr size_t s_SLOT_ALIGN = std::max({ alignof(void*), alignof(SizedNode<LeafNode>), alignof(SizedNode<InternalNode>) });
+
+		static constexpr size_t slotBytes(size_t nodeBytes) { return (nodeBytes + s_SLOT_ALIGN - 1) / s_SLOT_ALIGN * s_SLOT_ALIGN; }
+
+		/**
+		 * Bytes of a node slot per size class: leaves, then internal nodes.
+		 */
+		static constexpr size_t s_SLOT_BYTES[s_SIZE_CLASSES] = { slotBytes(s_LEAF_NODE_BYTES), slotBytes(s_INTERNAL_NODE_BYTES) };
+
+		static constexpr size_t s_SLOT_BITS = std::bit_width(s_BLOCK_NODES - 1);
+
+		/**
+		 * A handle holds the slot index, then the size class bit, then the block number.
+		 */
+		static constexpr size_t s_NUMBER_SHIFT = s_SLOT_BITS + 1;
+
+		static_assert(std::has_single_bit(s_BLOCK_NODES), "node handles split into block number and slot bits");
+
+		static size_t sizeClass(bool isLeaf) { return isLeaf ? 0 : 1; }
+		static constexpr size_t blockBytes(size_t cls) { return s_BLOCK_NODES * s_SLOT_BYTES[cls]; }
+
+		/**
+		 * The node living in a slot of the given size class.
+		 */
+		static Node* slotNode(uint8_t* slot, size_t cls)
+		{
+			if (cls == 0) {
+				return reinterpret_cast<SizedNode<LeafNode>*>(slot);
+			}
+
+			return reinterpret_cast<SizedNode<InternalNode>*>(slot);
+		}
+
+		/**
+		 * Process-wide table from block numbers to the blocks of all pools of this tree type,
+		 * through which `NodeHandle`s are resolved. Numbers are handed out and returned under
+		 * `mutex`; lookups go without it, as a tree only resolves handles into blocks it holds.
+		 * Number 0 is never handed out so that a zero handle means no node.
+		 */
+		struct BlockDirectory
+		{
+			static constexpr size_t s_PAGE_BITS = 12;
+			static constexpr size_t s_PAGES = size_t(1) << (32 - s_NUMBER_SHIFT - s_PAGE_BITS);
+
+			static inline std::unique_ptr<uint8_t*[]> pages[s_PAGES];
+			static inline std::vector<uint32_t> freeNumbers;
+			static inline uint32_t nextNumber{1};
+			static inline std::mutex mutex;
+
+			static uint32_t acquire(uint8_t* block);
+			static void release(uint32_t number);
+
+			static Node* resolve(uint32_t index)
+			{
+				if (!index) {
+					return nullptr;
+				}
+
+				const uint32_t number = index >> s_NUMBER_SHIFT;
+				const size_t cls = (index >> s_SLOT_BITS) & 1;
+				uint8_t* block = pages[number >> s_PAGE_BITS][number & ((1u << s_PAGE_BITS) - 1)];
+
+				return slotNode(block + (index & (s_BLOCK_NODES - 1)) * s_SLOT_BYTES[cls], cls);
+			}
+		};
+
+		/**
+		 * Block allocator for nodes. Every block holds `s_BLOCK_NODES` slots of one size
+		 * class (leaves or internal nodes), each as large as a node of that kind rounded up
+		 * to `s_SLOT_ALIGN`. Released slots are threaded onto a free list per size class and
+		 * handed out again before a new block is added.
+		 */
+		struct NodePool
+		{
+			/**
+			 * Overlay written into a released slot to link it into its free list.
+			 */
+			struct FreeSlot
+			{
+				FreeSlot* next;
+				[[no_unique_address]] std::conditional_t<s_COMPACT_HANDLES, uint32_t, NoSummary> handle;
+			};
+
+			static_assert(alignof(FreeSlot) <= s_SLOT_ALIGN && sizeof(FreeSlot) <= std::min(s_SLOT_BYTES[0], s_SLOT_BYTES[1]), "a free slot overlay fits every slot");
+
+			/**
+			 * The memory of a block and its size class, and with `compactHandles` its number
+			 * in the `BlockDirectory`, held for as long as the block lives.
+			 */
+			struct Block
+			{
+				std::unique_ptr<uint8_t[]> memory;
+				size_t cls;
+				[[no_unique_address]] std::conditional_t<s_COMPACT_HANDLES, uint32_t, NoSummary> number;
+
+				Block(std::unique_ptr<uint8_t[]> mem, size_t sizeClass);
+				Block(Block &&other) noexcept;
+				Block& operator=(Block &&other) noexcept;
+				~Block();
+
+				uint8_t* get() const { return memory.get(); }
+			};
+
+			std::vector<Block> blocks;
+
+			/**
+			 * The block each size class bump-allocates from, nullptr before its first node.
+			 */
+			uint8_t* currentBlock[s_SIZE_CLASSES]{};
+			size_t offset[s_SIZE_CLASSES];
+			uint32_t currentNumber[s_SIZE_CLASSES]{};
+			FreeSlot* freeLists[s_SIZE_CLASSES]{};
+			FreeSlot* freeTails[s_SIZE_CLASSES]{};
+			size_t liveSlots{0};
+			size_t liveBytes{0};
+			size_t freeSlots{0};
+
+			/**
+			 * Address ranges of the blocks being emptied by `compact`, sorted.
+			 */
+			std::vector<std::pair<const uint8_t*, const uint8_t*>> retiring;
+
+			/**
+			 * Live nodes still inside the retiring blocks.
+			 */
+			size_t retiringLive{0};
+
+			NodePool();
+
+			void addBlock(size_t cls);
+
+			/**
+			 * Handle of the slot at byte `at` of the current block of size class `cls`.
+			 */
+			uint32_t bumpHandle(size_t cls, size_t at) const
+			{
+				return (currentNumber[cls] << s_NUMBER_SHIFT) | static_cast<uint32_t>(cls << s_SLOT_BITS)
+					| static_cast<uint32_t>(at / s_SLOT_BYTES[cls]);
+			}
+
+			/**
+			 * Closes the bump block of every size class, so the next node opens a fresh one.
+			 */
+			void closeBumpBlocks();
+
+			Node* allocate(bool isLeaf);
+			void release(Node* node);
+
+			/**
+			 * Takes over all blocks and free slots of `other`, leaving it without blocks.
+			 * Neither pool may be retiring.
+			 */
+			void adopt(NodePool &other);
+
+			/**
+			 * Marks all current blocks as retiring and drops their free slots; new nodes go to
+			 * fresh blocks.
+			 */
+			void beginRetire();
+
+			/**
+			 * Returns true if the node lives in a retiring block.
+			 */
+			bool retires(const Node* node) const;
+
+			/**
+			 * Frees the retiring blocks. Requires `retiringLive == 0`.
+			 */
+			void finishRetire();
+		};
+
+		/**
+		 * The pool the nodes live in, shared by the trees cut apart with `split`. It has no
+		 * locking, so trees sharing it must be used from one thread.
+		 */
+		std::shared_ptr<NodePool> m_nodePool = std::make_shared<NodePool>();
+
+		/**
+		 * Wraps a detached subtree allocated from `pool` into a tree of its own.
+		 */
+		BTree(const Compare &comp, std::shared_ptr<NodePool> pool, Node* root, size_t size);
+
+		/**
+		 * Progress of an incremental `compact` pass. Levels are walked root first; `resume`
+		 * is the separator in front of the next node to visit on level `depth` (empty for
+		 * the leftmost node), so the position survives structural changes between calls.
+		 */
+		struct CompactCursor
+		{
+			bool active{false};
+			size_t depth{0};
+			size_t height{0};
+			std::optional<Key> resume;
+		};
+
+		CompactCursor m_Compact;
+
+		size_t height() const;
+
+		Node* allocateNode(bool isLeaf);
+		void releaseNode(Node *node);
+		size_t destroyNode(Node *node);
+
+		/**
+		 * Hands the root over to its only child for as long as it is an internal node
+		 * without keys.
+		 */
+		void collapseRoot();
+
+		/**
+		 * A detached subtree while the tree is cut apart and glued back together.
+		 */
+		struct Subtree
+		{
+			/**
+			 * The root node, or nullptr for an empty subtree.
+			 */
+			Node* root;
+
+			/**
+			 * Number of internal levels above the leaves.
+			 */
+			size_t height;
+		};
+
+		/**
+		 * Cuts a subtree into the entries before `key` and the rest; with `inclusive`,
+		 * an entry equal to `key` goes to the first part. The leaf chain is cut between
+		 * the parts. The nodes on the descent path are divided into per-level pieces that
+		 * are joined back together, so the cost is O(height).
+		 *
+		 * @return The (before, from) subtrees; their roots may be underfull.
+		 */
+		std::pair<Subtree, Subtree> splitSubtree(Subtree tree, const Key &key, bool inclusive);
+
+		/**
+		 * Joins two subtrees whose key ranges do not overlap, `left` sorting first.
+		 *
+		 * The shorter root is hung next to the inner spine of the taller one at its own
+		 * level and then borrows from or merges with its new sibling if it underflows.
+		 * Full nodes met on the way down are split first, like `insert` does. Links the
+		 * leaf chains at the seam. Costs O(height difference + 1).
+		 */
+		Subtree joinSubtrees(Subtree left, Subtree right);
+
+		/**
+		 * Copies a subtree living in another pool into this tree's pool node by node,
+		 * releasing the originals into `from`, and relinks its leaves after `prevLeaf`.
+		 *
+		 * @return The copy of `node`.
+		 */
+		Node* adoptSubtree(Node* node, NodePool &from, Node* &prevLeaf);
+
+		/**
+		 * Merges `other` into this tree. `resolve(left, std::move(right))` settles a key
+		 * present in both by leaving the surviving value in `left`.
+		 */
+		template <typename Resolve>
+		void mergeTrees(BTree &&other, Resolve resolve);
 
-			friend class BTree;
+		/**
+		 * A position in the leaf chain; `leaf` is nullptr past the last entry.
+		 */
+		struct LeafCursor
+		{
+			Node* leaf;
+			size_t index;
 		};
 
 		/**
-		 * @brief Returns an iterator to the first (smallest) element.
-		 *
-		 * Starts a forward in-order traversal of the B+Tree,
-		 * yielding entries from low keys to high.
-		 *
-		 * @return Iterator pointing at the minimum key.
+		 * Walks this tree and `other` together in key order. Keys only on the left go to
+		 * `onLeft`, keys only on the right to `onRight`, common keys to `onBoth`. A side
+		 * whose unmatched keys are dropped (`SkipLeft`, `SkipRight`) catches up with
+		 * `seek` instead of stepping entry by entry.
 		 */
-		Iterator begin();
+		template <bool SkipLeft, bool SkipRight, typename OnLeft, typename OnRight, typename OnBoth>
+		void mergeWalk(const BTree &other, OnLeft onLeft, OnRight onRight, OnBoth onBoth) const;
 
 		/**
-		 * @brief Returns an iterator one past the last element.
-		 *
-		 * @return End iterator.
-		*/
-		Iterator end() noexcept;
+		 * Moves a cursor of this tree forward to the first key >= `key`: by a binary search
+		 * in the current or the next leaf, or by a descent from the root when `key` lies
+		 * beyond the next leaf.
+		 */
+		void seek(LeafCursor &cursor, const Key &key) const;
 
 		/**
-		 * @brief Returns a reverse iterator to the last (largest) element.
-		 *
-		 * Starts a reverse in-order traversal of the B+Tree,
-		 * yielding entries from high keys down to low.
-		 *
-		 * @return A std::reverse_iterator over Iterator, initially pointing at the maximum key.
-		*/
-		std::reverse_iterator<Iterator> rbegin();
+		 * Exchanges the contents of the two trees, pools included.
+		 */
+		void swapContents(BTree &other);
 
 		/**
-		 * @brief Returns a reverse iterator one past the first (smallest) element.
-		 *
-		 * This marks the end of a reverse in-order traversal.
-		 *
-		 * @return A std::reverse_iterator over Iterator at the rend position.
+		 * Releases every node and leaves a single empty leaf as the root.
 		 */
-		std::reverse_iterator<Iterator> rend() noexcept;
+		void resetToEmpty();
 
 		/**
-		 * @brief Destroys the B-Tree, freeing all internal nodes.
-		 *
-		*/
-		~BTree();
-
-	private:
-		Node* m_Root;
-		Compare m_Comp;
-		size_t m_Size{0};
-		static constexpr size_t s_BLOCK_NODES = 1024;
-		static constexpr size_t s_BLOCK_BYTES = s_BLOCK_NODES * sizeof(Node);
+		 * Builds the internal levels over a chain of leaves packed front to back and makes
+		 * it the contents of the tree, releasing the old nodes. An underfull last leaf is
+		 * evened out with its neighbour first.
+		 */
+		void adoptLeafChain(Node* head, Node* tail, size_t count, size_t fanout);
 
-		struct NodePool
+		/**
+		 * One internal node on a root-to-leaf path.
+		 */
+		struct PathEntry
 		{
-			std::vector<std::unique_ptr<uint8_t[]>> blocks;
-			uint8_t* currentBlock;
-			size_t offset;
+			/**
+			 * The internal node.
+			 */
+			Node* node;
 
-			NodePool();
+			/**
+			 * The index of the child the path continues into.
+			 */
+			size_t childIdx;
 
-			void addBlock();
-			Node* allocate(bool isLeaf);
+			/**
+			 * Exclusive upper bound on the keys of `node`'s subtree, or nullptr when the
+			 * subtree is the rightmost one. Points into an ancestor's separator keys.
+			 */
+			const Key* high;
 		};
 
-		NodePool m_nodePool;
+		/**
+		 * Returns the order in which `insertBatch` visits the pairs of a batch:
+		 * indices into the batch sorted by key, equal keys kept in batch order.
+		 *
+		 * @param batch The pairs to sort.
+		 * @return A permutation of [0, batch.size()).
+		 */
+		std::vector<size_t> batchOrder(std::span<const std::pair<Key, Value>> batch) const;
+
+		/**
+		 * Merges a sorted run of batch pairs into the leaf that owns all of them.
+		 *
+		 * Overwrites the values of keys already in the leaf, then moves the tail of the
+		 * leaf that follows the first new key aside and merges it with the new keys. When
+		 * the result does not fit, it is spread evenly over the leaf and as many new leaves
+		 * as needed, linked into the leaf chain right after it.
+		 *
+		 * @param leaf     The leaf whose key range covers the whole run.
+		 * @param batch    The batch being inserted.
+		 * @param order    Sorted indices into `batch`, see `batchOrder`.
+		 * @param begin    First position of the run in `order`.
+		 * @param end      One past the last position of the run in `order`.
+		 * @param siblings Receives (separator, leaf) for every new leaf, in key order.
+		 * @return The number of new keys added to the tree.
+		 */
+		size_t mergeRunIntoLeaf(Node* leaf, std::span<const std::pair<Key, Value>> batch,
+			const std::vector<size_t> &order, size_t begin, size_t end,
+			std::vector<std::pair<Key, Node*>> &siblings);
 
-		Node* allocateNode(bool isLeaf);
-		void destroyNode(Node *node);
+		/**
+		 * Inserts new right siblings of a node into its parent, splitting the parent into
+		 * as many nodes as needed when they do not fit and repeating one level up, up to
+		 * growing a new root.
+		 *
+		 * @param path     Path from the root to the parent of the node that produced the
+		 *                 siblings; its last entry's `childIdx` is that node. Consumed.
+		 * @param siblings (separator, node) pairs in key order, to go right after that child.
+		 */
+		void insertSiblings(std::vector<PathEntry> &path, std::vector<std::pair<Key, Node*>> &&siblings);
+
+		/**
+		 * Moves `node` into a newly allocated slot and repoints its parent (the last entry
+		 * of `path`, or the root) and, for leaves, both leaf neighbours at the copy.
+		 */
+		Node* relocateNode(Node* node, const std::vector<PathEntry> &path);
+
+		/**
+		 * Returns true if `key` sorts after every key in the tree, i.e. it can be appended
+		 * to `m_LastLeaf`.
+		 */
+		bool isAppend(const Key &key) const;
+
+		/**
+		 * Appends a key greater than every key in the tree to the rightmost leaf. A full leaf
+		 * is not split in half: it stays full and the key starts a new leaf, whose separator
+		 * is pushed up the right spine the same way (a full internal node keeps all but its
+		 * last child and hands that one to the new node).
+		 */
+		void appendLast(const Key &key, const Value &value);
 
 		/**
 		 * Divides a full child node into two siblings by moving the upper half of its
@@ -401,6 +2342,29 @@ class BTree
 		*/
 		void splitChild(Node* parent, size_t index);
 
+		/**
+		 * Splits `count` children into groups of `target` for one internal level of a
+		 * bulk build. When the last group would be below `minSize` it is merged into
+		 * the one before it, or the two are split evenly if that would exceed `maxSize`.
+		 *
+		 * @param count   Number of children on the level below.
+		 * @param target  Preferred number of children per node.
+		 * @param minSize Minimum number of children per node.
+		 * @param maxSize Maximum number of children per node.
+		 * @return The number of children of each node of the new level, in order.
+		*/
+		static std::vector<size_t> bulkGroupSizes(size_t count, size_t target, size_t minSize, size_t maxSize);
+
+		/**
+		 * Builds the internal levels of a bulk-loaded tree on top of a level of nodes.
+		 *
+		 * @param level  The nodes of the bottom level, in key order, each paired with the
+		 *               smallest key of its subtree. Consumed by the call.
+		 * @param fanout Preferred number of children per internal node.
+		 * @return The root of the tree.
+		*/
+		Node* buildInternalLevels(std::vector<std::pair<Node*, Key>> &level, size_t fanout);
+
 		/**
 		 * Inserts a key–value pair into a node that is guaranteed not to be full.
 		 *
@@ -419,12 +2383,12 @@ class BTree
 		bool insertNonFull(Node* node, const Key& key, const Value& value);
 
 		/**
-		 * Rebalances a leaf node that has fallen below the minimum entry threshold.
+		 * Restores a leaf that underflowed after a removal.
 		 *
-		 * This method restores a leaf’s capacity by first attempting to borrow an entry
-		 * from its immediate left or right sibling. If neither sibling has spare entries,
-		 * it merges the underfull leaf with one sibling and updates the parent’s keys
-		 * and child pointers accordingly.
+		 * With `BTreeUnderflowPolicy::Rebalance` the leaf borrows an entry from its left
+		 * or right sibling if one has entries to spare, and is otherwise merged with one of
+		 * them. With `BTreeUnderflowPolicy::MergeWhenEmpty` the (empty) leaf is unlinked
+		 * from the leaf chain and its parent and released.
 		 *
 		 * @param leaf      Pointer to the leaf node that needs rebalancing.
 		 * @param parent    Pointer to the parent node containing the separator key
@@ -434,13 +2398,13 @@ class BTree
 		void rebalanceLeaf(Node* leaf, Node* parent, size_t index);
 
 		/**
-		 * Rebalances an internal node that has fallen below the minimum key threshold.
+		 * Restores an internal node that underflowed after one of its children was
+		 * merged away.
 		 *
-		 * This method restores an internal node’s capacity by first attempting to
-		 * borrow a key–child pair from its immediate left or right sibling. If neither
-		 * sibling has extra keys, it merges the underfull node with one sibling,
-		 * pulls down the separator key from the parent, and updates the parent’s keys
-		 * and child pointers accordingly.
+		 * With `BTreeUnderflowPolicy::Rebalance` the node borrows a key–child pair through
+		 * the parent from a sibling with keys to spare, and is otherwise merged with one of
+		 * them. With `BTreeUnderflowPolicy::MergeWhenEmpty` the (childless) node is removed
+		 * from its parent and released.
 		 *
 		 * @param node      Pointer to the internal node that needs rebalancing.
 		 * @param parent    Pointer to the parent node containing separator keys
@@ -450,60 +2414,20 @@ class BTree
 		void rebalanceInternal(Node* node, Node* parent, size_t index);
 
 		/**
-		 * Removes a key from the subtree rooted at `node`, preserving B-Tree invariants.
-		 *
-		 * This routine handles three major scenarios:
-		 * 1. If `node` is a leaf and contains `key`, it erases the entry directly.
-		 * 2. If `node` is internal and contains `key`, it replaces `key` with its
-		 *    predecessor or successor—or merges children when neither side can lend—
-		 *    then continues removal in the affected subtree.
-		 * 3. If `key` is not present in `node`, it locates the correct child slot,
-		 *    ensures that child has enough entries (borrowing or merging if underflow),
-		 *    and recurses into that child.
-		 *
-		 * @param  node     Pointer to the node where removal begins.
-		 * @param  key      The key to remove from the tree.
-		*/
-		void removeFromNode(Node *node, const Key &key);
-
-		/**
-		 * Finds the in-order predecessor of the key at the given child index.
+		 * Removes the child at `index` and the separator next to it from `parent`.
+		 * The left neighbour (or, for the first child, the right one) takes over its key range.
 		 *
-		 * Starting from the child pointer at `node->children[idx]`, this method
-		 * descends down to the rightmost leaf in that subtree and returns its
-		 * last entry’s key. This key serves as the predecessor for
-		 * `node->keys[idx]` when replacing or deleting internal-node keys.
-		 *
-		 * @param  node     Pointer to the internal node whose predecessor is sought.
-		 * @param  idx      Child index in `node->children` from which to start.
-		 * @return          The largest key in the subtree rooted at `node->children[idx]`.
-		*/
-		Key getPredecessor(Node *node, size_t idx) const;
-
-		/**
-		 * Finds the in-order successor of the key at the given child index.
-		 *
-		 * Starting from the child pointer at `node->children[idx + 1]`, this method
-		 * descends down to the leftmost leaf in that subtree and returns its
-		 * first entry’s key. This key serves as the successor for
-		 * `node->keys[idx]` when replacing or deleting internal-node keys.
-		 *
-		 * @param  node     Pointer to the internal node whose successor is sought.
-		 * @param  idx      Child index in `node->children` preceding the target subtree.
-		 * @return          The smallest key in the subtree rooted at `node->children[idx + 1]`.
+		 * @param  parent   Pointer to the parent node.
+		 * @param  index    Index in `parent->children` of the child to drop.
 		*/
-		Key getSuccessor(Node *node, size_t idx) const;
+		void eraseChild(Node* parent, size_t index);
 
 		/**
-		 * Ensures that the child at index `idx` has at least the minimum number of
-		 * keys or entries by borrowing from a sibling or merging when underflow occurs.
+		 * Brings the underfull child at index `idx` back to its minimum size by borrowing
+		 * from a sibling that can spare an entry (or key), merging it with an adjacent
+		 * sibling when neither can.
 		 *
-		 * If the immediate left or right sibling of the underflowing child has enough
-		 * entries (or keys for internal nodes), this method borrows one and updates
-		 * the parent’s separator key. If neither sibling can lend, it merges the child
-		 * with an adjacent sibling and adjusts the parent’s keys and child pointers.
-		 *
-		 * @param  node     Pointer to the parent node whose child may underflow.
+		 * @param  node     Pointer to the parent node whose child underflowed.
 		 * @param  idx      The index in `node->children` of the child to fill.
 		*/
 		void fill(Node *node, size_t idx);
@@ -542,6 +2466,375 @@ class BTree
 		*/
 		void mergeNodes(Node *node, size_t idx);
 
+		/**
+		 * Returns the index of the first key in `keys[0, n)` that is not less than `key`,
+		 * using the SIMD kernel when the key type and comparator allow it.
+		 * @param keys Pointer to the first key of a sorted array.
+		 * @param n Number of keys in the array.
+		 * @param key The key to look for.
+		 * @return The lower-bound index in [0, n].
+		 */
+		inline size_t keyLowerBound(const Key* keys, size_t n, const Key& key) const
+		{
+			if constexpr (btree_simd_searchable<Key, Compare>) {
+				return simd_lower_bound(keys, n, key);
+			} else {
+				return std::lower_bound(keys, keys + n, key, m_Comp) - keys;
+			}
+		}
+
+		/**
+		 * Returns the index of the first key in `keys[0, n)` that is greater than `key`,
+		 * using the SIMD kernel when the key type and comparator allow it.
+		 * @param keys Pointer to the first key of a sorted array.
+		 * @param n Number of keys in the array.
+		 * @param key The key to look for.
+		 * @return The upper-bound index in [0, n].
+		 */
+		inline size_t keyUpperBound(const Key* keys, size_t n, const Key& key) const
+		{
+			if constexpr (btree_simd_searchable<Key, Compare>) {
+				return simd_upper_bound(keys, n, key);
+			} else {
+				return std::upper_bound(keys, keys + n, key, m_Comp) - keys;
+			}
+		}
+
+		/**
+		 * Returns the key of a separator, with or without an abbreviation attached.
+		 */
+		static inline const Key& separatorKey(const SeparatorKey& separator)
+		{
+			if constexpr (s_ABBREVIATED) {
+				return separator.key;
+			} else {
+				return separator;
+			}
+		}
+
+		/**
+		 * Moves the key out of a separator that is about to be dropped.
+		 */
+		static inline Key&& takeSeparatorKey(SeparatorKey& separator)
+		{
+			if constexpr (s_ABBREVIATED) {
+				return std::move(separator.key);
+			} else {
+				return std::move(separator);
+			}
+		}
+
+		/**
+		 * Returns the index of the child of an internal node whose subtree may hold `key`.
+		 *
+		 * Separators are copies of the first key of their right subtree, so a key
+		 * equal to a separator descends to its right.
+		 * @param node An internal node.
+		 * @param key The key to look for.
+		 * @return Index into `node->internal().children`.
+		 */
+		inline size_t childIndex(const Node* node, const Key& key) const
+		{
+			auto const &keys = node->internal().keys;
+
+			if constexpr (s_ABBREVIATED) {
+				const uint64_t abbrev = Abbreviation::abbreviate(key);
+				auto it = std::upper_bound(keys.begin(), keys.end(), key,
+					[this, abbrev](const Key &k, const AbbreviatedKey &separator) {
+						return abbrev != separator.abbrev ? abbrev < separator.abbrev : less(k, separator.key);
+					});
+
+				return std::distance(keys.begin(), it);
+			} else {
+				return keyUpperBound(keys.data(), keys.size(), key);
+			}
+		}
+
+		/**
+		 * Returns the leftmost leaf below `node`.
+		 */
+		static inline Node* firstLeaf(Node* node)
+		{
+			while (!node->isLeaf) {
+				node = node->internal().children.front();
+			}
+
+			return node;
+		}
+
+		/**
+		 * Returns the rightmost leaf below `node`.
+		 */
+		static inline Node* lastLeaf(Node* node)
+		{
+			while (!node->isLeaf) {
+				node = node->internal().children.back();
+			}
+
+			return node;
+		}
+
+		/**
+		 * Descends from the root to the leaf whose key range contains `key`.
+		 * @param key The key to look for.
+		 * @return The leaf that holds `key` if it is in the tree.
+		 */
+		inline Node* findLeaf(const Key& key) const
+		{
+			Node* node = m_Root;
+
+			while (!node->isLeaf) {
+				node = node->internal().children[childIndex(node, key)];
+			}
+
+			return node;
+		}
+
+		/**
+		 * Builds an iterator at entry `index` of `leaf`, moving on to the next leaf
+		 * (or to `end()`) when the index is past the last entry.
+		 * @param leaf A leaf node.
+		 * @param index Index of the entry in the leaf.
+		 * @return Iterator at the first entry at or after the position.
+		 */
+		inline Iterator iteratorAt(Node* leaf, size_t index)
+		{
+			while (leaf && index >= leaf->leaf().size()) {
+				leaf = leaf->leaf().nextLeaf;
+				index = 0;
+			}
+
+			return Iterator(this, leaf, index);
+		}
+
+		/**
+		 * Returns the index of the first entry of a leaf whose key is not less than `key`.
+		 * @param node A leaf node.
+		 * @param key The key to look for.
+		 * @return Index of the entry in the leaf, equal to its size if every key is less.
+		 */
+		inline size_t leafLowerBound(const Node* node, const Key& key) const
+		{
+			if constexpr (s_PREFIX_LEAVES) {
+				return node->leaf().lowerBound(key);
+			} else if constexpr (s_ABBREVIATED) {
+				// the comparator only settles the run of keys whose abbreviation ties
+				auto const &abbrevs = node->leaf().abbrevs;
+				const uint64_t abbrev = Abbreviation::abbreviate(key);
+				size_t low = std::lower_bound(abbrevs.begin(), abbrevs.end(), abbrev) - abbrevs.begin();
+				size_t high = std::upper_bound(abbrevs.begin() + low, abbrevs.end(), abbrev) - abbrevs.begin();
+
+				while (low < high) {
+					size_t mid = (low + high) / 2;
+
+					if (less(node->leaf().key(mid), key)) {
+						low = mid + 1;
+					} else {
+						high = mid;
+					}
+				}
+
+				return low;
+			} else if constexpr (s_SPLIT_LEAVES) {
+				return keyLowerBound(node->leaf().keys.data(), node->leaf().keys.size(), key);
+			} else {
+				auto const &entries = node->leaf().entries;
+				auto it = std::lower_bound(
+					entries.begin(),
+					entries.end(),
+					key,
+					[this](auto const &entry, auto const &v) { return less(entry.first, v); }
+				);
+
+				return std::distance(entries.begin(), it);
+			}
+		}
+
+		/**
+		 * Tells whether entry `idx` of a leaf, as found by `leafLowerBound`, holds `key`.
+		 * @param node A leaf node.
+		 * @param idx An index in [0, size] of the leaf.
+		 * @param key The key to look for.
+		 * @return True if the entry exists and its key equals `key`.
+		 */
+		inline bool leafHolds(const Node* node, size_t idx, const Key& key) const
+		{
+			if (idx >= node->leaf().size()) {
+				return false;
+			}
+
+			if constexpr (s_PREFIX_LEAVES) {
+				return node->leaf().holds(idx, key);
+			} else if constexpr (s_ABBREVIATED) {
+				return node->leaf().abbrevs[idx] == Abbreviation::abbreviate(key) && !less(key, node->leaf().key(idx));
+			} else {
+				return !less(key, node->leaf().key(idx));
+			}
+		}
+
+		/**
+		 * Issues prefetches for the first cache lines of a node, which hold its
+		 * header and the first of its keys.
+		 * @param node The node that is about to be searched.
+		 */
+		static inline void prefetchNode(const Node* node)
+		{
+			constexpr size_t bytes = std::min(s_LEAF_NODE_BYTES, s_INTERNAL_NODE_BYTES);
+			constexpr size_t lines = std::min<size_t>(4, (bytes + BTREE_CACHE_LINE - 1) / BTREE_CACHE_LINE);
+			const char* base = reinterpret_cast<const char*>(node);
+
+			for (size_t i = 0; i < lines; ++i) {
+				BTREE_PREFETCH(base + i * BTREE_CACHE_LINE);
+			}
+		}
+
+		/**
+		 * Checks whether a node holds as many entries (leaf) or keys (internal)
+		 * as its capacity allows and must be split before an insert goes through it.
+		 * @param node The node to check.
+		 * @return True if the node is at its maximum size.
+		 */
+		static inline bool isFull(const Node* node)
+		{
+			return node->isLeaf
+				? node->leaf().size() >= BTree::s_LEAF_MAX_KEYS
+				: node->internal().keys.size() >= BTree::s_INTERNAL_MAX_KEYS;
+		}
+
+		/**
+		 * Checks whether a node holds more than its minimum number of entries (leaf)
+		 * or keys (internal), so it can give one up to a sibling or a removal. A node
+		 * that cannot lend may be below the minimum after appends (see the class
+		 * comment); merging it with an underflowing sibling still fits in one node.
+		 * @param node The node to check.
+		 * @return True if the node is above its minimum size.
+		 */
+		static inline bool canLend(const Node* node)
+		{
+			return node->isLeaf
+				? node->leaf().size() > BTree::s_LEAF_MIN_KEYS
+				: node->internal().keys.size() > BTree::s_INTERNAL_MIN_KEYS;
+		}
+
+		/**
+		 * Returns the number of entries in the subtree rooted at `node`, in O(fanout).
+		 */
+		static inline size_t subtreeCount(const Node* node)
+		{
+			if (node->isLeaf) {
+				return node->leaf().size();
+			}
+
+			size_t total = 0;
+
+			for (auto const &child : node->internal().children) {
+				total += child.count;
+			}
+
+			return total;
+		}
+
+		/**
+		 * Returns the aggregate of the entries in the subtree rooted at `node`, in O(fanout).
+		 */
+		static inline AggregateValue subtreeAggregate(const Node* node)
+		{
+			AggregateValue total = Aggregate::identity();
+
+			if (node->isLeaf) {
+				for (size_t i = 0; i < node->leaf().size(); ++i) {
+					total = Aggregate::combine(total, Aggregate::lift(node->leaf().key(i), node->leaf().value(i)));
+				}
+			} else {
+				for (auto const &child : node->internal().children) {
+					total = Aggregate::combine(total, child.aggregate);
+				}
+			}
+
+			return total;
+		}
+
+		/**
+		 * Recomputes the summary stored next to `parent->children[idx]` from the child's
+		 * contents. A no-op unless the tree is augmented.
+		 */
+		inline void refreshChild(Node* parent, size_t idx)
+		{
+			if constexpr (s_AUGMENTED) {
+				auto &slot = parent->internal().children[idx];
+
+				if constexpr (s_ORDER_STATS) {
+					slot.count = subtreeCount(slot.node);
+				}
+
+				if constexpr (s_AGGREGATE) {
+					slot.aggregate = subtreeAggregate(slot.node);
+				}
+			}
+		}
+
+		/**
+		 * Recomputes the summaries of every child of `parent`.
+		 */
+		inline void refreshChildren(Node* parent)
+		{
+			if constexpr (s_AUGMENTED) {
+				for (size_t i = 0; i < parent->internal().children.size(); ++i) {
+					refreshChild(parent, i);
+				}
+			}
+		}
+
+		/**
+		 * Recomputes the summaries of the children a root-to-leaf path goes through,
+		 * deepest first, after the leaf at its end was modified.
+		 */
+		inline void refreshPath(std::span<const PathEntry> path)
+		{
+			if constexpr (s_AUGMENTED) {
+				for (size_t level = path.size(); level > 0; --level) {
+					refreshChild(path[level - 1].node, path[level - 1].childIdx);
+				}
+			}
+		}
+
+		/**
+		 * Recomputes the summaries of the last two children of every node on the right
+		 * spine, deepest first, after an append.
+		 */
+		void refreshRightSpine();
+
+		/**
+		 * Counts the keys less than `key`, or less than or equal to it when `inclusive`.
+		 */
+		size_t countBelow(const Key &key, bool inclusive) const;
+
+		/**
+		 * Aggregates the entries of the subtree rooted at `node` that are not below `low`
+		 * and not above `high`; a null bound leaves that side open.
+		 */
+		AggregateValue aggregateNode(const Node* node, const Key* low, const Key* high) const;
+
+		/**
+		 * Checks whether a non-root node has to be fixed up under the configured
+		 * `BTreeUnderflowPolicy`.
+		 * @param node The node to check.
+		 * @return True if the node is below its minimum size (or empty, for MergeWhenEmpty).
+		 */
+		static inline bool underflows(const Node* node)
+		{
+			if constexpr (BTree::s_MERGE_WHEN_EMPTY)
+			{
+				return node->isLeaf ? node->leaf().empty() : node->internal().children.empty();
+			}
+			else
+			{
+				return node->isLeaf
+					? node->leaf().size() < BTree::s_LEAF_MIN_KEYS
+					: node->internal().keys.size() < BTree::s_INTERNAL_MIN_KEYS;
+			}
+		}
+
 		/**
 		 * Compares two keys, wrapper function for `Compare m_Comp`
 		 * @param a The first key to compare.
@@ -553,6 +2846,28 @@ class BTree
 			return m_Comp(a, b);
 		}
 
+
+		/**
+		 * Returns the separator between two adjacent leaves: the first key of the right
+		 * leaf, or with `s_TRUNCATE_SEPARATORS` its shortest prefix that still sorts
+		 * after the last key of the left leaf. Either way the left keys are less than the
+		 * separator and the right keys are not, which is all `childIndex` relies on.
+		 * @param leftLast The last key of the left leaf.
+		 * @param rightFirst The first key of the right leaf.
+		 * @return The key to store in the parent.
+		 */
+		inline Key separatorBetween(const Key& leftLast, const Key& rightFirst) const
+		{
+			if constexpr (s_TRUNCATE_SEPARATORS) {
+				// leftLast < rightFirst, so they differ before rightFirst ends
+				auto cut = std::mismatch(leftLast.begin(), leftLast.end(), rightFirst.begin(), rightFirst.end()).second;
+
+				return Key(rightFirst.begin(), cut + 1);
+			} else {
+				return rightFirst;
+			}
+		}
+
 	friend class Iterator;
 };
 
@@ -3,6 +3,24 @@
 #include <random>
 #include <chrono>
 #include <string>
+#include <map>
+#include <algorithm>
+#include <ranges>
+#include <cstdio>
+#include <deque>
+
+int failures = 0;
+
+/**
+ * Records a result that differs from its reference; main() exits non-zero if any did.
+ */
+void check(bool ok, const char *what) {
+	if (!ok)
+	{
+		std::cout << "CHECK FAILED: " << what << std::endl;
+		++failures;
+	}
+}
 
 void jsonSerializationTests(BTree<int, std::string>& tree) {
 	const int insertions = 11;
@@ -20,7 +38,72 @@ void jsonSerializationTests(BTree<int, std::string>& tree) {
 	std::cout << tree.serializeToJson() << std::endl;
 }
 
-void standardTests(BTree<int, std::string>& tree) {
+/**
+ * Leaves that keep keys and values in separate arrays, compared against the
+ * default array-of-pairs layout by running standardTests on both.
+ */
+struct SplitLeafTraits : BTreeDefaultTraits
+{
+	static constexpr BTreeLeafLayout leafLayout = BTreeLeafLayout::SplitKeysValues;
+};
+
+using SplitLeafTree = BTree<
+	int,
+	std::string,
+	std::less<int>,
+	BTreeDefaultLeafCapacity<int, std::string>,
+	BTreeDefaultInternalCapacity<int>,
+	SplitLeafTraits>;
+
+struct MergeWhenEmptyTraits : BTreeDefaultTraits
+{
+	static constexpr BTreeUnderflowPolicy underflowPolicy = BTreeUnderflowPolicy::MergeWhenEmpty;
+};
+
+struct OrderStatisticsTraits : BTreeDefaultTraits
+{
+	static constexpr bool orderStatistics = true;
+};
+
+/**
+ * Sum of the values, e.g. bytes per time window.
+ */
+struct SumAggregate
+{
+	using value_type = long long;
+
+	static value_type identity() { return 0; }
+	static value_type combine(const value_type &a, const value_type &b) { return a + b; }
+	static value_type lift(const int &, const int &value) { return value; }
+};
+
+struct SumAggregateTraits : BTreeDefaultTraits
+{
+	using Aggregate = SumAggregate;
+};
+
+struct PrefixLeafTraits : BTreeDefaultTraits
+{
+	static constexpr BTreeLeafLayout leafLayout = BTreeLeafLayout::PrefixCompressed;
+};
+
+struct AbbreviatedKeyTraits : BTreeDefaultTraits
+{
+	using Abbreviation = BTreeStringAbbreviation;
+};
+
+struct CompactHandleTraits : BTreeDefaultTraits
+{
+	static constexpr bool compactHandles = true;
+};
+
+struct TruncatedSeparatorTraits : BTreeDefaultTraits
+{
+	static constexpr bool truncateSeparators = true;
+};
+
+template <typename Tree>
+void standardTests(Tree& tree) {
 	const int insertions = 1e6;
 	const int middle = insertions / 2;
 
@@ -139,6 +222,15 @@ void standardTests(BTree<int, std::string>& tree) {
 
 	std::cout << "Range2: [5] " << *range2[5].second << std::endl;
 
+	size_t resumed = 0;
+
+	for (auto it = tree.lower_bound(*firstResultKey), last = tree.upper_bound(*lastResultKey); it != last; ++it)
+	{
+		resumed++;
+	}
+
+	std::cout << "lower_bound-scan-size: " << resumed << "\tfind: " << (*tree.find(*firstResultKey)).second << std::endl;
+
 	tree[*firstResultKey] = std::string("AALLOOOOO");
 
 	std::cout << "X2 sa moar copii mei valoarea lu cristos " << *firstResultValue << std::endl;
@@ -180,6 +272,26 @@ void standardTests(BTree<int, std::string>& tree) {
 	auto duration_searchHeavy = std::chrono::duration_cast<std::chrono::milliseconds>(t1_searchHeavy - t0_searchHeavy).count();
 
 	std::cout << "search-heavy-time: " << duration_searchHeavy << std::endl;
+
+	std::vector<std::string*> batchResults(heavySearchKeys.size());
+	size_t batchHolder = 0;
+
+	auto t0_searchBatch = std::chrono::steady_clock::now();
+
+	tree.searchBatch(heavySearchKeys, batchResults);
+
+	for (std::string* result : batchResults)
+	{
+		if (result)
+			batchHolder++;
+	}
+
+	auto t1_searchBatch = std::chrono::steady_clock::now();
+
+	auto duration_searchBatch = std::chrono::duration_cast<std::chrono::milliseconds>(t1_searchBatch - t0_searchBatch).count();
+
+	std::cout << "search-batch-holder: " << batchHolder << std::endl;
+	std::cout << "search-batch-time: " << duration_searchBatch << std::endl;
 }
 
 void orderedMapTests() {
@@ -241,14 +353,1658 @@ void orderedMapTests() {
 	std::cout << "ordered-map-items-found: " << itemsFound << std::endl;
 }
 
-int main() {
-	auto tree = std::make_unique<BTree<int, std::string>>();
+void bulkLoadTests() {
+	std::cout << "=========== bulkLoadTests ===========" << std::endl;
 
-	standardTests(*tree);
+	const int insertions = 1e6;
 
-	orderedMapTests();
+	unsigned seed = std::chrono::system_clock::now().time_since_epoch().count();
+	std::mt19937 generate(seed);
+
+	std::vector<std::pair<int, std::string>> sorted;
+
+	sorted.reserve(insertions);
+
+	for (int i = 0; i < insertions; ++i)
+	{
+		sorted.emplace_back(static_cast<int>(generate()), "1");
+	}
+
+	std::sort(sorted.begin(), sorted.end(), [](auto const &a, auto const &b) { return a.first < b.first; });
+
+	BTree<int, std::string> inserted;
+
+	auto t0_insert = std::chrono::steady_clock::now();
+
+	for (auto const &[key, value] : sorted)
+	{
+		inserted.insert(key, value);
+	}
+
+	auto t1_insert = std::chrono::steady_clock::now();
+
+	BTree<int, std::string> loaded;
+
+	auto t0_bulk = std::chrono::steady_clock::now();
+
+	loaded.bulkLoad(sorted.begin(), sorted.end());
+
+	auto t1_bulk = std::chrono::steady_clock::now();
+
+	auto duration_insert = std::chrono::duration_cast<std::chrono::milliseconds>(t1_insert - t0_insert).count();
+	auto duration_bulk = std::chrono::duration_cast<std::chrono::milliseconds>(t1_bulk - t0_bulk).count();
+
+	std::cout << "sorted-insert-time: " << duration_insert << "\tsize: " << inserted.size() << std::endl;
+	std::cout << "bulk-load-time: " << duration_bulk << "\tsize: " << loaded.size() << std::endl;
+}
+
+void rangeViewTests() {
+	std::cout << "=========== rangeViewTests ===========" << std::endl;
+
+	const int count = 2e6;
+
+	std::vector<std::pair<int, int>> sorted;
+
+	sorted.reserve(count);
+
+	for (int i = 0; i < count; ++i)
+	{
+		sorted.emplace_back(i, i);
+	}
+
+	BTree<int, int> tree(sorted.begin(), sorted.end());
+
+	const int low = count / 4;
+	const int high = low + 1e6 - 1;
+
+	auto t0_vector = std::chrono::steady_clock::now();
+
+	long long vectorSum = 0;
+
+	for (auto [key, value] : tree.range(low, high))
+	{
+		vectorSum += *value;
+	}
+
+	auto t1_vector = std::chrono::steady_clock::now();
+
+	long long viewSum = 0;
+
+	for (auto [key, value] : tree.rangeView(low, high))
+	{
+		viewSum += value;
+	}
+
+	auto t1_view = std::chrono::steady_clock::now();
+
+	int firstOdd = -1;
+
+	for (auto [key, value] : tree.rangeView(low, high) | std::views::filter([](auto entry) { return entry.first % 2 == 1; }) | std::views::take(1))
+	{
+		firstOdd = key;
+	}
+
+	auto t1_early = std::chrono::steady_clock::now();
+
+	auto latest = tree.rangeReverse(high, 10);
+	long long latestSum = 0;
+
+	for (auto [key, value] : tree.rangeViewReverse(low, high) | std::views::take(10))
+	{
+		latestSum += value;
+	}
+
+	auto t1_reverse = std::chrono::steady_clock::now();
+
+	std::cout << "range-vector-time: " << std::chrono::duration_cast<std::chrono::microseconds>(t1_vector - t0_vector).count()
+		<< "us\tsum: " << vectorSum << std::endl;
+	std::cout << "range-view-time: " << std::chrono::duration_cast<std::chrono::microseconds>(t1_view - t1_vector).count()
+		<< "us\tsum: " << viewSum << std::endl;
+	std::cout << "range-view-early-exit-time: " << std::chrono::duration_cast<std::chrono::microseconds>(t1_early - t1_view).count()
+		<< "us\tfirst-odd: " << firstOdd << std::endl;
+	std::cout << "range-reverse-time: " << std::chrono::duration_cast<std::chrono::microseconds>(t1_reverse - t1_early).count()
+		<< "us\tlatest: " << *latest.front().first << ".." << *latest.back().first << "\tsum: " << latestSum << std::endl;
+}
+
+void orderStatisticsTests() {
+	std::cout << "=========== orderStatisticsTests ===========" << std::endl;
+
+	const int count = 1e6;
+	const int queries = 1e5;
+
+	std::vector<int> keys(count);
+
+	for (int i = 0; i < count; ++i)
+	{
+		keys[i] = i * 2;
+	}
+
+	unsigned seed = std::chrono::system_clock::now().time_since_epoch().count();
+	std::mt19937 gen(seed);
+	std::shuffle(keys.begin(), keys.end(), gen);
+
+	BTree<int, int> plain;
+	BTree<int, int, std::less<int>, BTreeDefaultLeafCapacity<int, int>, BTreeDefaultInternalCapacity<int>, OrderStatisticsTraits> counted;
+
+	auto t0_plain = std::chrono::steady_clock::now();
+
+	for (int key : keys)
+	{
+		plain.insert(key, key);
+	}
+
+	auto t1_plain = std::chrono::steady_clock::now();
+
+	for (int key : keys)
+	{
+		counted.insert(key, key);
+	}
+
+	auto t1_counted = std::chrono::steady_clock::now();
+
+	std::uniform_int_distribution<int> dist(0, count * 2);
+	std::vector<std::pair<int, int>> bounds(queries);
+
+	for (auto &[low, high] : bounds)
+	{
+		low = dist(gen);
+		high = low + dist(gen) / 10;
+	}
+
+	size_t scanned = 0;
+
+	for (auto [low, high] : bounds)
+	{
+		scanned += std::ranges::distance(plain.rangeView(low, high));
+	}
+
+	auto t1_scan = std::chrono::steady_clock::now();
+
+	size_t counts = 0;
+
+	for (auto [low, high] : bounds)
+	{
+		counts += counted.count(low, high);
+	}
+
+	auto t1_count = std::chrono::steady_clock::now();
+
+	std::vector<int> ranks(queries);
+
+	for (int &rank : ranks)
+	{
+		rank = gen() % count;
+	}
+
+	auto t0_select = std::chrono::steady_clock::now();
+
+	long long selected = 0;
+
+	for (int rank : ranks)
+	{
+		selected += (*counted.select(rank)).first;
+	}
+
+	auto t1_select = std::chrono::steady_clock::now();
+
+	long long expectedSelected = 0;
+
+	for (int rank : ranks)
+	{
+		expectedSelected += rank * 2;
+	}
+
+	check(counts == scanned, "order statistics count matches the range scan");
+	check(selected == expectedSelected, "select returns the key of each rank");
+	check((*counted.select(count / 2)).first == count, "select finds the median");
+	check(counted.rank(count) == static_cast<size_t>(count / 2), "rank counts the smaller keys");
+
+	auto duration_plain = std::chrono::duration_cast<std::chrono::milliseconds>(t1_plain - t0_plain).count();
+	auto duration_counted = std::chrono::duration_cast<std::chrono::milliseconds>(t1_counted - t1_plain).count();
+	auto duration_scan = std::chrono::duration_cast<std::chrono::milliseconds>(t1_scan - t1_counted).count();
+	auto duration_count = std::chrono::duration_cast<std::chrono::milliseconds>(t1_count - t1_scan).count();
+	auto duration_select = std::chrono::duration_cast<std::chrono::milliseconds>(t1_select - t0_select).count();
+
+	std::cout << "plain-insert-time: " << duration_plain << "\tcounted-insert-time: " << duration_counted << std::endl;
+	std::cout << "range-scan-count-time: " << duration_scan << "\ttotal: " << scanned << std::endl;
+	std::cout << "order-stats-count-time: " << duration_count << "\ttotal: " << counts << std::endl;
+	std::cout << "select-time: " << duration_select << "\tsum: " << selected
+		<< "\tmedian: " << (*counted.select(count / 2)).first << "\trank: " << counted.rank(count) << std::endl;
+}
+
+void aggregateTests() {
+	std::cout << "=========== aggregateTests ===========" << std::endl;
+
+	const int count = 1e6;
+	const int queries = 1e4;
+
+	std::vector<std::pair<int, int>> entries;
+
+	entries.reserve(count);
+
+	for (int i = 0; i < count; ++i)
+	{
+		entries.emplace_back(i, i % 1500);
+	}
+
+	BTree<int, int> plain(entries.begin(), entries.end());
+	BTree<int, int, std::less<int>, BTreeDefaultLeafCapacity<int, int>, BTreeDefaultInternalCapacity<int>, SumAggregateTraits> summed(entries.begin(), entries.end());
+
+	unsigned seed = std::chrono::system_clock::now().time_since_epoch().count();
+	std::mt19937 gen(seed);
+	std::uniform_int_distribution<int> dist(0, count);
+	std::vector<std::pair<int, int>> windows(queries);
+
+	for (auto &[low, high] : windows)
+	{
+		low = dist(gen);
+		high = low + dist(gen) / 10;
+	}
+
+	std::vector<long long> reducedWindows(queries);
+	std::vector<long long> aggregatedWindows(queries);
+
+	auto t0_reduce = std::chrono::steady_clock::now();
+
+	long long reduced = 0;
+
+	for (int i = 0; i < queries; ++i)
+	{
+		for (auto [key, value] : plain.range(windows[i].first, windows[i].second))
+		{
+			reducedWindows[i] += *value;
+		}
+
+		reduced += reducedWindows[i];
+	}
+
+	auto t1_reduce = std::chrono::steady_clock::now();
+
+	long long aggregated = 0;
+
+	for (int i = 0; i < queries; ++i)
+	{
+		aggregatedWindows[i] = summed.aggregate(windows[i].first, windows[i].second);
+		aggregated += aggregatedWindows[i];
+	}
+
+	auto t1_aggregate = std::chrono::steady_clock::now();
+
+	check(aggregatedWindows == reducedWindows, "aggregate matches the range reduce of every window");
+
+	// overwrites and removals keep the stored sums current
+	for (int i = 0; i < count; i += 7)
+	{
+		summed.insert(i, 0);
+		summed.remove(i + 1);
+	}
+
+	long long total = 0;
+
+	for (auto [key, value] : summed)
+	{
+		total += value;
+	}
+
+	auto duration_reduce = std::chrono::duration_cast<std::chrono::milliseconds>(t1_reduce - t0_reduce).count();
+	auto duration_aggregate = std::chrono::duration_cast<std::chrono::microseconds>(t1_aggregate - t1_reduce).count();
+
+	std::cout << "range-reduce-time: " << duration_reduce << "ms\tsum: " << reduced << std::endl;
+	std::cout << "aggregate-time: " << duration_aggregate << "us\tsum: " << aggregated << std::endl;
+	std::cout << "aggregate-after-updates: " << summed.aggregate(0, count) << "\texpected: " << total << std::endl;
+
+	check(summed.aggregate(0, count) == total, "aggregate stays current after overwrites and removals");
+}
+
+void eraseRangeTests() {
+	std::cout << "=========== eraseRangeTests ===========" << std::endl;
+
+	const int count = 4e6;
+	const int expired = count / 4;
+
+	std::vector<std::pair<int, int>> entries;
+
+	entries.reserve(count);
+
+	for (int i = 0; i < count; ++i)
+	{
+		entries.emplace_back(i, i);
+	}
+
+	BTree<int, int> perKey(entries.begin(), entries.end());
+	BTree<int, int> ranged(entries.begin(), entries.end());
+
+	auto t0_perKey = std::chrono::steady_clock::now();
+
+	for (int key = 0; key < expired; ++key)
+	{
+		perKey.remove(key);
+	}
+
+	auto t1_perKey = std::chrono::steady_clock::now();
+
+	size_t removed = ranged.eraseRange(0, expired - 1);
+
+	auto t1_ranged = std::chrono::steady_clock::now();
+
+	size_t sizeExpired = ranged.size();
+	auto statsExpired = ranged.poolStats();
+
+	// a window in the middle cuts both boundary paths
+	size_t middle = ranged.eraseRange(count / 2, count / 2 + expired);
+
+	auto t1_middle = std::chrono::steady_clock::now();
+
+	auto duration_perKey = std::chrono::duration_cast<std::chrono::milliseconds>(t1_perKey - t0_perKey).count();
+	auto duration_ranged = std::chrono::duration_cast<std::chrono::microseconds>(t1_ranged - t1_perKey).count();
+	auto duration_middle = std::chrono::duration_cast<std::chrono::microseconds>(t1_middle - t1_ranged).count();
+
+	std::cout << "per-key-remove-time: " << duration_perKey << "ms\tsize: " << perKey.size() << std::endl;
+	std::cout << "erase-range-time: " << duration_ranged << "us\tremoved: " << removed << "\tsize: " << sizeExpired
+		<< "\tlive: " << statsExpired.liveNodes << "\tfree: " << statsExpired.freeNodes << std::endl;
+	std::cout << "erase-range-middle-time: " << duration_middle << "us\tremoved: " << middle << "\tsize: " << ranged.size() << std::endl;
+
+	check(perKey.size() == static_cast<size_t>(count - expired), "per-key removal leaves the unexpired keys");
+	check(removed == static_cast<size_t>(expired) && sizeExpired == static_cast<size_t>(count - expired), "eraseRange removes the expired prefix");
+	check(middle == static_cast<size_t>(expired + 1), "eraseRange removes the middle window");
+
+	// the survivors are [expired, count / 2) and (count / 2 + expired, count), in order
+	int expected = expired;
+	bool ordered = true;
+
+	for (auto [key, value] : ranged)
+	{
+		if (expected == count / 2)
+		{
+			expected += expired + 1;
+		}
+
+		ordered = ordered && key == expected && value == expected;
+		++expected;
+	}
+
+	check(ordered && expected == count, "eraseRange keeps every key outside the erased windows");
+}
+
+void splitJoinTests() {
+	std::cout << "=========== splitJoinTests ===========" << std::endl;
+
+	const int count = 4e6;
+
+	std::vector<std::pair<int, int>> entries;
+
+	entries.reserve(count);
+
+	for (int i = 0; i < count; ++i)
+	{
+		entries.emplace_back(i, i);
+	}
+
+	BTree<int, int> reinserted(entries.begin(), entries.end());
+	BTree<int, int> upper;
+
+	auto t0_reinsert = std::chrono::steady_clock::now();
+
+	// the old way: copy the upper partition out and remove it
+	for (auto [key, value] : reinserted.rangeView(count / 3, count))
+	{
+		upper.insert(key, value);
+	}
+
+	reinserted.eraseRange(count / 3, count);
+
+	auto t1_reinsert = std::chrono::steady_clock::now();
+
+	BTree<int, int> tree(entries.begin(), entries.end());
+
+	auto t0_split = std::chrono::steady_clock::now();
+
+	BTree<int, int> partition = tree.split(count / 3);
+
+	auto t1_split = std::chrono::steady_clock::now();
+
+	size_t lowerSize = tree.size();
+	size_t upperSize = partition.size();
+
+	check(lowerSize == static_cast<size_t>(count / 3) && upperSize == static_cast<size_t>(count - count / 3), "split sizes both halves");
+	check(tree.search(count / 3 - 1) && !tree.search(count / 3), "split keeps the keys below the cut");
+	check(partition.search(count / 3) && !partition.search(count / 3 - 1), "split moves the keys from the cut on");
+
+	auto t0_join = std::chrono::steady_clock::now();
+
+	tree.join(std::move(partition));
+
+	auto t1_join = std::chrono::steady_clock::now();
+
+	int expected = 0;
+
+	for (auto [key, value] : tree)
+	{
+		if (key != expected || value != expected)
+		{
+			break;
+		}
+
+		++expected;
+	}
+
+	check(tree.size() == static_cast<size_t>(count) && partition.size() == 0, "join takes every entry of the partition");
+	check(expected == count, "join restores the original key sequence");
+	check(reinserted.size() == lowerSize && upper.size() == upperSize, "reinsert moves the upper partition");
+
+	// with order statistics the moved count comes from rank() instead of the leaf walk
+	BTree<int, int, std::less<int>, BTreeDefaultLeafCapacity<int, int>, BTreeDefaultInternalCapacity<int>, OrderStatisticsTraits> counted(entries.begin(), entries.begin() + count / 4);
+	auto countedPartition = counted.split(count / 10);
+
+	check(counted.size() == static_cast<size_t>(count / 10) && countedPartition.size() == static_cast<size_t>(count / 4 - count / 10), "split sizes order statistics trees from rank");
+	check(countedPartition.rank(count / 5) == static_cast<size_t>(count / 5 - count / 10), "split keeps the counts of the moved subtrees");
+
+	auto duration_reinsert = std::chrono::duration_cast<std::chrono::milliseconds>(t1_reinsert - t0_reinsert).count();
+	auto duration_split = std::chrono::duration_cast<std::chrono::microseconds>(t1_split - t0_split).count();
+	auto duration_join = std::chrono::duration_cast<std::chrono::microseconds>(t1_join - t0_join).count();
+
+	std::cout << "reinsert-partition-time: " << duration_reinsert << "ms\tsizes: " << reinserted.size() << "/" << upper.size() << std::endl;
+	std::cout << "split-time: " << duration_split << "us\tsizes: " << lowerSize << "/" << upperSize << std::endl;
+	std::cout << "join-time: " << duration_join << "us\tsize: " << tree.size() << "\tpartition: " << partition.size() << std::endl;
+}
+
+void mergeFromTests() {
+	std::cout << "=========== mergeFromTests ===========" << std::endl;
+
+	const int count = 2e6;
+	const int delta = 5e5;
+
+	std::vector<std::pair<int, int>> mainEntries;
+	std::vector<std::pair<int, int>> deltaEntries;
+
+	mainEntries.reserve(count);
+	deltaEntries.reserve(delta);
+
+	for (int i = 0; i < count; ++i)
+	{
+		mainEntries.emplace_back(i * 2, i);
+	}
+
+	// half of the delta overwrites existing keys, the other half is new
+	for (int i = 0; i < delta; ++i)
+	{
+		deltaEntries.emplace_back(i * 8 + (i % 2), -i);
+	}
+
+	BTree<int, int> inserted(mainEntries.begin(), mainEntries.end());
+	BTree<int, int> insertedDelta(deltaEntries.begin(), deltaEntries.end());
+
+	auto t0_insert = std::chrono::steady_clock::now();
+
+	// the old way: iterate the delta and insert it key by key
+	for (auto [key, value] : insertedDelta)
+	{
+		if (int* existing = inserted.search(key))
+		{
+			*existing = value;
+		}
+		else
+		{
+			inserted.insert(key, value);
+		}
+	}
+
+	auto t1_insert = std::chrono::steady_clock::now();
+
+	BTree<int, int> merged(mainEntries.begin(), mainEntries.end());
+	BTree<int, int> mergedDelta(deltaEntries.begin(), deltaEntries.end());
+
+	auto t0_merge = std::chrono::steady_clock::now();
+
+	merged.mergeFrom(std::move(mergedDelta), BTreeConflictPolicy::KeepRight);
+
+	auto t1_merge = std::chrono::steady_clock::now();
+
+	BTree<int, int> summed(mainEntries.begin(), mainEntries.end());
+	BTree<int, int> tiny;
+
+	for (int i = 0; i < 1000; ++i)
+	{
+		tiny.insert(i * 4, 1);
+	}
+
+	auto t0_tiny = std::chrono::steady_clock::now();
+
+	summed.mergeFrom(std::move(tiny), [](const int &left, const int &right) { return left + right; });
+
+	auto t1_tiny = std::chrono::steady_clock::now();
+
+	auto duration_insert = std::chrono::duration_cast<std::chrono::milliseconds>(t1_insert - t0_insert).count();
+	auto duration_merge = std::chrono::duration_cast<std::chrono::milliseconds>(t1_merge - t0_merge).count();
+	auto duration_tiny = std::chrono::duration_cast<std::chrono::microseconds>(t1_tiny - t0_tiny).count();
+
+	std::cout << "insert-delta-time: " << duration_insert << "ms\tsize: " << inserted.size() << std::endl;
+	std::cout << "merge-delta-time: " << duration_merge << "ms\tsize: " << merged.size() << "\tdelta: " << mergedDelta.size() << std::endl;
+	std::cout << "merge-tiny-time: " << duration_tiny << "us\tsize: " << summed.size() << "\tvalue at 4: " << *summed.search(4) << std::endl;
+
+	check(inserted.size() == static_cast<size_t>(count + delta / 2), "per-key merge adds the new delta keys");
+	check(merged.size() == inserted.size() && mergedDelta.size() == 0, "mergeFrom takes every entry of the delta");
+	check(std::ranges::equal(merged, inserted), "mergeFrom KeepRight matches the per-key merge");
+
+	bool combined = summed.size() == static_cast<size_t>(count);
+
+	for (int i = 0; i < 1000; ++i)
+	{
+		combined = combined && *summed.search(i * 4) == i * 2 + 1;
+	}
+
+	check(combined, "mergeFrom combines the values of common keys");
+
+	// conflicts resolved in place must reach the stored sums, on both merge paths and either way round
+	using SummedTree = BTree<int, int, std::less<int>, BTreeDefaultLeafCapacity<int, int>, BTreeDefaultInternalCapacity<int>, SumAggregateTraits>;
+
+	auto sumOf = [](SummedTree &tree) {
+		long long total = 0;
+
+		for (auto [key, value] : tree)
+		{
+			total += value;
+		}
+
+		return total;
+	};
+
+	SummedTree large(mainEntries.begin(), mainEntries.end());
+	SummedTree few;
+
+	for (int i = 0; i < 1000; ++i)
+	{
+		few.insert(i * 4, 1);
+		few.insert(count * 2 + i, 1);
+	}
+
+	large.mergeFrom(std::move(few), [](const int &left, const int &right) { return left + right; });
+
+	check(large.aggregate(0, count * 3) == sumOf(large), "aggregate after merging a small tree in");
+
+	SummedTree small;
+
+	for (int i = 0; i < 1000; ++i)
+	{
+		small.insert(i * 6, 7);
+	}
+
+	small.mergeFrom(std::move(large), BTreeConflictPolicy::KeepLeft);
+
+	check(small.aggregate(0, count * 3) == sumOf(small), "aggregate after merging into a small tree");
+
+	SummedTree big(deltaEntries.begin(), deltaEntries.end());
+
+	big.mergeFrom(std::move(small), BTreeConflictPolicy::KeepRight);
+
+	check(big.aggregate(0, count * 8) == sumOf(big), "aggregate after merging two large trees");
+}
+
+void setOperatorTests() {
+	std::cout << "=========== setOperatorTests ===========" << std::endl;
+
+	const int count = 2e6;
+	const int sparse = 2e3;
+
+	std::vector<std::pair<int, int>> entries;
+	std::vector<std::pair<int, int>> sparseEntries;
+
+	entries.reserve(count);
+	sparseEntries.reserve(sparse);
+
+	for (int i = 0; i < count; ++i)
+	{
+		entries.emplace_back(i, i);
+	}
+
+	// every third sparse key misses the dense tree
+	for (int i = 0; i < sparse; ++i)
+	{
+		sparseEntries.emplace_back(i * (count / sparse) * (i % 3 ? 1 : -1), i);
+	}
+
+	std::sort(sparseEntries.begin(), sparseEntries.end());
+
+	BTree<int, int> dense(entries.begin(), entries.end());
+	BTree<int, int> small(sparseEntries.begin(), sparseEntries.end());
+
+	auto t0_search = std::chrono::steady_clock::now();
+
+	size_t searched = 0;
+
+	// the old way: look every key of one tree up in the other
+	for (auto [key, value] : dense)
+	{
+		if (small.search(key))
+		{
+			++searched;
+		}
+	}
+
+	auto t1_search = std::chrono::steady_clock::now();
+
+	size_t intersected = dense.intersect(small, [](const int &, const int &) {});
+
+	auto t1_intersect = std::chrono::steady_clock::now();
+
+	long long joined = 0;
+
+	dense.join(small, [&joined](const int &, const int &left, const int &right) { joined += left - right; });
+
+	auto t1_join = std::chrono::steady_clock::now();
+
+	size_t different = small.difference(dense, [](const int &, const int &) {});
+	size_t symmetric = small.symmetricDifference(dense, [](const int &, const int &) {});
+
+	auto t1_difference = std::chrono::steady_clock::now();
+
+	auto duration_search = std::chrono::duration_cast<std::chrono::microseconds>(t1_search - t0_search).count();
+	auto duration_intersect = std::chrono::duration_cast<std::chrono::microseconds>(t1_intersect - t1_search).count();
+	auto duration_join = std::chrono::duration_cast<std::chrono::microseconds>(t1_join - t1_intersect).count();
+	auto duration_difference = std::chrono::duration_cast<std::chrono::microseconds>(t1_difference - t1_join).count();
+
+	std::cout << "per-key-search-time: " << duration_search << "us\tcommon: " << searched << std::endl;
+	std::cout << "intersect-time: " << duration_intersect << "us\tcommon: " << intersected << std::endl;
+	std::cout << "join-time: " << duration_join << "us\tsum: " << joined << std::endl;
+	std::cout << "difference-time: " << duration_difference << "us\tdifference: " << different << "\tsymmetric: " << symmetric << std::endl;
+
+	// the dense keys are [0, count), so a sparse key is common exactly when it falls inside
+	size_t common = 0;
+	long long expectedJoined = 0;
+
+	for (auto [key, value] : sparseEntries)
+	{
+		if (key >= 0 && key < count)
+		{
+			++common;
+			expectedJoined += key - value;
+		}
+	}
+
+	check(searched == common && intersected == common, "intersect counts the common keys");
+	check(joined == expectedJoined, "join reports both values of every common key");
+	check(different == sparseEntries.size() - common, "difference counts the keys missing from the other tree");
+	check(symmetric == sparseEntries.size() + entries.size() - 2 * common, "symmetricDifference counts the keys of exactly one tree");
+}
+
+template <typename Tree>
+long long timeStringLookups(const std::vector<std::string> &keys, const std::vector<std::string> &probes) {
+	Tree tree;
+
+	for (const std::string &key : keys)
+	{
+		tree.insert(key, 1);
+	}
+
+	size_t found = 0;
+	auto t0 = std::chrono::steady_clock::now();
+
+	for (const std::string &probe : probes)
+	{
+		found += tree.search(probe) != nullptr;
+	}
+
+	auto t1 = std::chrono::steady_clock::now();
+
+	if (found != probes.size())
+	{
+		std::cout << "missing keys: " << probes.size() - found << std::endl;
+	}
+
+	check(found == probes.size(), "every inserted string key is found");
+
+	return std::chrono::duration_cast<std::chrono::milliseconds>(t1 - t0).count();
+}
+
+void truncatedSeparatorTests() {
+	std::cout << "=========== truncatedSeparatorTests ===========" << std::endl;
+
+	const int insertions = 5e5;
+
+	std::mt19937 generate(42);
+	std::vector<std::string> keys;
+
+	keys.reserve(insertions);
+
+	// path-like keys: a short distinguishing head and a long shared tail
+	for (int i = 0; i < insertions; ++i)
+	{
+		keys.push_back("t/" + std::to_string(generate()) + "/buckets/production-assets/objects/"
+			+ std::to_string(generate() % 100) + "/thumbnail.png");
+	}
+
+	std::vector<std::string> probes = keys;
+
+	std::shuffle(probes.begin(), probes.end(), generate);
+
+	auto duration_full = timeStringLookups<BTree<std::string, int>>(keys, probes);
+	auto duration_truncated = timeStringLookups<BTree<
+		std::string,
+		int,
+		std::less<std::string>,
+		BTreeDefaultLeafCapacity<std::string, int>,
+		BTreeDefaultInternalCapacity<std::string>,
+		TruncatedSeparatorTraits>>(keys, probes);
+
+	std::cout << "full-separator-search-time: " << duration_full << "ms" << std::endl;
+	std::cout << "truncated-separator-search-time: " << duration_truncated << "ms" << std::endl;
+}
+
+/**
+ * Returns the keys collected by `range` and `rangeReverse`, so the layouts can be compared.
+ */
+template <typename Tree>
+std::vector<std::string> timePrefixLeaves(const char *label, const std::vector<std::string> &keys, const std::vector<std::string> &probes) {
+	Tree tree;
+
+	for (const std::string &key : keys)
+	{
+		tree.insert(key, 1);
+	}
+
+	size_t found = 0;
+	auto t0_search = std::chrono::steady_clock::now();
+
+	for (const std::string &probe : probes)
+	{
+		found += tree.search(probe) != nullptr;
+	}
+
+	auto t1_search = std::chrono::steady_clock::now();
+
+	size_t scanned = 0;
+
+	for (auto [key, value] : tree.rangeView(std::string("tenant/00010"), std::string("tenant/00060")))
+	{
+		scanned += key.size() + value;
+	}
+
+	auto t1_scan = std::chrono::steady_clock::now();
+
+	auto duration_search = std::chrono::duration_cast<std::chrono::milliseconds>(t1_search - t0_search).count();
+	auto duration_scan = std::chrono::duration_cast<std::chrono::microseconds>(t1_scan - t1_search).count();
+
+	std::cout << label << "-search-time: " << duration_search << "ms\tfound: " << found
+		<< "\tscan-time: " << duration_scan << "us\tscanned: " << scanned
+		<< "\tnode-bytes: " << tree.poolStats().liveBytes << std::endl;
+
+	check(found == probes.size(), "every inserted key is found");
+
+	std::vector<std::string> collected;
+
+	for (auto [key, value] : tree.range(std::string("tenant/00020"), std::string("tenant/00021")))
+	{
+		collected.push_back(*key);
+	}
+
+	for (auto [key, value] : tree.range(std::string("tenant/00050"), size_t{100}))
+	{
+		collected.push_back(*key);
+	}
+
+	for (auto [key, value] : tree.rangeReverse(std::string("tenant/00070"), 100))
+	{
+		collected.push_back(*key);
+	}
+
+	return collected;
+}
+
+void prefixLeafTests() {
+	std::cout << "=========== prefixLeafTests ===========" << std::endl;
+
+	const int insertions = 5e5;
+
+	std::mt19937 generate(7);
+	std::vector<std::string> keys;
+
+	keys.reserve(insertions);
+
+	// tenant/path keys: each leaf holds a run sharing a long prefix
+	for (int i = 0; i < insertions; ++i)
+	{
+		char tenant[16];
+
+		std::snprintf(tenant, sizeof(tenant), "%05u", static_cast<unsigned>(generate() % 100));
+		keys.push_back(std::string("tenant/") + tenant + "/collections/documents/items/" + std::to_string(generate() % 1000000));
+	}
+
+	std::vector<std::string> probes = keys;
+
+	std::shuffle(probes.begin(), probes.end(), generate);
+
+	// the key heap allocations of the array-of-pairs leaves are not counted by node-bytes
+	auto pairs = timePrefixLeaves<BTree<std::string, int>>("array-of-pairs", keys, probes);
+	auto prefixed = timePrefixLeaves<BTree<std::string, int, std::less<std::string>, 64, BTreeDefaultInternalCapacity<std::string>, PrefixLeafTraits>>("prefix-compressed", keys, probes);
+
+	check(!pairs.empty() && prefixed == pairs, "range and rangeReverse rebuild the prefix-compressed keys");
+}
+
+void abbreviatedKeyTests() {
+	std::cout << "=========== abbreviatedKeyTests ===========" << std::endl;
+
+	const int insertions = 5e5;
+
+	std::mt19937 generate(13);
+	std::vector<std::string> keys;
+
+	keys.reserve(insertions);
+
+	// hex object ids: the first 8 bytes almost always tell two keys apart, the heap-held rest rarely matters
+	for (int i = 0; i < insertions; ++i)
+	{
+		char id[40];
+
+		std::snprintf(id, sizeof(id), "%08x%08x%08x%08x",
+			static_cast<unsigned>(generate()), static_cast<unsigned>(generate()),
+			static_cast<unsigned>(generate()), static_cast<unsigned>(generate()));
+		keys.push_back(std::string(id) + "/revisions/latest");
+	}
+
+	std::vector<std::string> probes = keys;
+
+	std::shuffle(probes.begin(), probes.end(), generate);
+
+	auto duration_full = timeStringLookups<BTree<std::string, int>>(keys, probes);
+	auto duration_abbreviated = timeStringLookups<BTree<std::string, int, std::less<std::string>,
+		BTreeDefaultLeafCapacity<std::string, int>, BTreeDefaultInternalCapacity<std::string>, AbbreviatedKeyTraits>>(keys, probes);
+
+	std::cout << "full-key-search-time: " << duration_full << "ms" << std::endl;
+	std::cout << "abbreviated-key-search-time: " << duration_abbreviated << "ms" << std::endl;
+}
+
+template <typename Tree>
+void timeNodeHandles(const char *label, const std::vector<int> &keys, const std::vector<int> &probes) {
+	Tree tree;
+
+	for (int key : keys)
+	{
+		tree.insert(key, key);
+	}
+
+	size_t found = 0;
+	auto t0 = std::chrono::steady_clock::now();
+
+	for (int probe : probes)
+	{
+		found += tree.search(probe) != nullptr;
+	}
+
+	auto t1 = std::chrono::steady_clock::now();
+
+	std::cout << label << "-search-time: " << std::chrono::duration_cast<std::chrono::milliseconds>(t1 - t0).count()
+		<< "ms\tfound: " << found
+		<< "\tinternal-node-bytes: " << Tree::s_INTERNAL_NODE_BYTES
+		<< "\tleaf-node-bytes: " << Tree::s_LEAF_NODE_BYTES
+		<< "\tpool-bytes: " << tree.poolStats().liveBytes << std::endl;
+}
+
+void nodeHandleTests() {
+	std::cout << "=========== nodeHandleTests ===========" << std::endl;
+
+	const int insertions = 2e6;
+
+	std::mt19937 generate(5);
+	std::vector<int> keys(insertions);
+
+	for (int &key : keys)
+	{
+		key = static_cast<int>(generate());
+	}
+
+	std::vector<int> probes = keys;
+
+	std::shuffle(probes.begin(), probes.end(), generate);
+
+	constexpr size_t leaf = BTreeDefaultLeafCapacity<int, int>;
+	constexpr size_t internal = BTreeDefaultInternalCapacity<int>;
+
+	// the same internal node bytes hold more separators once the child links shrink to 4 bytes
+	constexpr size_t widened = BTREE_NODE_CACHE_LINES * BTREE_CACHE_LINE / (sizeof(int) + sizeof(uint32_t));
+
+	timeNodeHandles<BTree<int, int>>("pointers", keys, probes);
+	timeNodeHandles<BTree<int, int, std::less<int>, leaf, internal, CompactHandleTraits>>("handles", keys, probes);
+	timeNodeHandles<BTree<int, int, std::less<int>, leaf, widened, CompactHandleTraits>>("handles-widened", keys, probes);
+}
+
+template <typename Tree, typename Value>
+void timeNodeStorage(const char *label, const std::vector<int> &keys, const std::vector<int> &probes, const Value &value) {
+	Tree tree;
+
+	for (int key : keys)
+	{
+		tree.insert(key, value);
+	}
+
+	size_t found = 0;
+	auto t0 = std::chrono::steady_clock::now();
+
+	for (int probe : probes)
+	{
+		found += tree.search(probe) != nullptr;
+	}
+
+	auto t1 = std::chrono::steady_clock::now();
+
+	std::cout << label << "-search-time: " << std::chrono::duration_cast<std::chrono::milliseconds>(t1 - t0).count()
+		<< "ms\tfound: " << found
+		<< "\tinternal-node-bytes: " << Tree::s_INTERNAL_NODE_BYTES
+		<< "\tleaf-node-bytes: " << Tree::s_LEAF_NODE_BYTES
+		<< "\tpool-bytes: " << tree.poolStats().liveBytes << std::endl;
+}
+
+/**
+ * The node storage before the inline arrays, kept as the baseline of nodeStorageTests:
+ * one union of small_vector-backed leaf and internal bodies per node, with the header
+ * after it. Built bottom-up like the tree's bulk load and searched with the same kernels,
+ * so only the storage differs.
+ */
+template <typename Value, size_t LeafCapacity, size_t InternalCapacity>
+class SmallVectorNodeBaseline
+{
+	struct Node;
+
+	struct Leaf
+	{
+		boost::container::small_vector<std::pair<int, Value>, LeafCapacity + 1> entries;
+	};
+
+	struct Internal
+	{
+		boost::container::small_vector<int, InternalCapacity> keys;
+		boost::container::small_vector<Node*, InternalCapacity + 1> children;
+	};
+
+	struct Node
+	{
+		union
+		{
+			Internal internal;
+			Leaf leaf;
+		};
+
+		bool isLeaf;
+		Node* nextLeaf = nullptr;
+		Node* prevLeaf = nullptr;
+
+		explicit Node(bool leafNode) : isLeaf(leafNode)
+		{
+			if (isLeaf)
+			{
+				new (&leaf) Leaf();
+				leaf.entries.reserve(LeafCapacity + 1);
+			}
+			else
+			{
+				new (&internal) Internal();
+			}
+		}
+
+		~Node()
+		{
+			if (isLeaf)
+			{
+				leaf.~Leaf();
+			}
+			else
+			{
+				internal.~Internal();
+			}
+		}
+	};
+
+	std::deque<Node> m_Nodes;
+	Node* m_Root = nullptr;
+
+	public:
+		static constexpr size_t s_NODE_BYTES = sizeof(Node);
+
+		SmallVectorNodeBaseline(const std::vector<std::pair<int, Value>> &sorted, double fillFactor)
+		{
+			const size_t perLeaf = std::max<size_t>(1, static_cast<size_t>(LeafCapacity * fillFactor + 0.5));
+			const size_t perInternal = std::max<size_t>(2, static_cast<size_t>((InternalCapacity + 1) * fillFactor + 0.5));
+			std::vector<std::pair<int, Node*>> level;
+			Node* prev = nullptr;
+
+			for (size_t i = 0; i < sorted.size(); i += perLeaf)
+			{
+				Node &leaf = m_Nodes.emplace_back(true);
+
+				leaf.leaf.entries.assign(sorted.begin() + i, sorted.begin() + std::min(i + perLeaf, sorted.size()));
+				leaf.prevLeaf = prev;
+
+				if (prev)
+				{
+					prev->nextLeaf = &leaf;
+				}
+
+				prev = &leaf;
+				level.emplace_back(sorted[i].first, &leaf);
+			}
+
+			while (level.size() > 1)
+			{
+				std::vector<std::pair<int, Node*>> parents;
+
+				for (size_t i = 0; i < level.size(); i += perInternal)
+				{
+					Node &parent = m_Nodes.emplace_back(false);
+
+					for (size_t j = i; j < std::min(i + perInternal, level.size()); ++j)
+					{
+						if (j > i)
+						{
+							parent.internal.keys.push_back(level[j].first);
+						}
+
+						parent.internal.children.push_back(level[j].second);
+					}
+
+					parents.emplace_back(level[i].first, &parent);
+				}
+
+				level = std::move(parents);
+			}
+
+			m_Root = level.empty() ? nullptr : level.front().second;
+		}
+
+		const Value* search(int key) const
+		{
+			const Node* node = m_Root;
+
+			if (!node)
+			{
+				return nullptr;
+			}
+
+			while (!node->isLeaf)
+			{
+				auto const &keys = node->internal.keys;
+				size_t idx;
+
+				if constexpr (btree_simd_searchable<int, std::less<int>>)
+				{
+					idx = simd_upper_bound(keys.data(), keys.size(), key);
+				}
+				else
+				{
+					idx = std::upper_bound(keys.begin(), keys.end(), key) - keys.begin();
+				}
+
+				node = node->internal.children[idx];
+			}
+
+			auto const &entries = node->leaf.entries;
+			auto it = std::lower_bound(entries.begin(), entries.end(), key, [](auto const &entry, int k) { return entry.first < k; });
+
+			return it != entries.end() && it->first == key ? &it->second : nullptr;
+		}
+
+		size_t nodes() const { return m_Nodes.size(); }
+};
+
+/**
+ * Bulk-loads the tree and the small_vector baseline with the same entries and fill factor,
+ * then times the same lookups on both.
+ */
+template <typename Tree, typename Value>
+void compareNodeStorage(const char *label, const std::vector<int> &keys, const std::vector<int> &probes, const Value &value) {
+	std::vector<std::pair<int, Value>> sorted;
+
+	sorted.reserve(keys.size());
+
+	for (int key : keys)
+	{
+		sorted.emplace_back(key, value);
+	}
+
+	std::sort(sorted.begin(), sorted.end(), [](auto const &a, auto const &b) { return a.first < b.first; });
+	sorted.erase(std::unique(sorted.begin(), sorted.end(), [](auto const &a, auto const &b) { return a.first == b.first; }), sorted.end());
+
+	using Baseline = SmallVectorNodeBaseline<Value, Tree::s_LEAF_MAX_KEYS, Tree::s_INTERNAL_MAX_KEYS>;
+
+	Tree tree(sorted.begin(), sorted.end(), 0.75);
+	Baseline baseline(sorted, 0.75);
+
+	size_t foundBaseline = 0;
+	auto t0_baseline = std::chrono::steady_clock::now();
+
+	for (int probe : probes)
+	{
+		foundBaseline += baseline.search(probe) != nullptr;
+	}
+
+	auto t1_baseline = std::chrono::steady_clock::now();
+
+	size_t foundTree = 0;
+
+	for (int probe : probes)
+	{
+		foundTree += tree.search(probe) != nullptr;
+	}
+
+	auto t1_tree = std::chrono::steady_clock::now();
+
+	std::cout << label << "-small-vector-search-time: " << std::chrono::duration_cast<std::chrono::milliseconds>(t1_baseline - t0_baseline).count()
+		<< "ms\tnode-bytes: " << Baseline::s_NODE_BYTES
+		<< "\tnodes: " << baseline.nodes() << std::endl;
+	std::cout << label << "-inline-array-search-time: " << std::chrono::duration_cast<std::chrono::milliseconds>(t1_tree - t1_baseline).count()
+		<< "ms\tleaf-node-bytes: " << Tree::s_LEAF_NODE_BYTES
+		<< "\tinternal-node-bytes: " << Tree::s_INTERNAL_NODE_BYTES
+		<< "\tnodes: " << tree.poolStats().liveNodes << std::endl;
+
+	check(foundBaseline == probes.size() && foundTree == probes.size(), "both node storages find every key");
+}
+
+void nodeStorageTests() {
+	std::cout << "=========== nodeStorageTests ===========" << std::endl;
+
+	const int insertions = 2e6;
+
+	std::mt19937 generate(9);
+	std::vector<int> keys(insertions);
+
+	for (int &key : keys)
+	{
+		key = static_cast<int>(generate());
+	}
+
+	std::vector<int> probes = keys;
+
+	std::shuffle(probes.begin(), probes.end(), generate);
+
+	timeNodeStorage<BTree<int, int>>("int-int", keys, probes, 1);
+	timeNodeStorage<BTree<int, std::string>>("int-string", keys, probes, std::string("value"));
+
+	// the same shape in the layout before the inline arrays, for a before/after comparison
+	compareNodeStorage<BTree<int, int>>("int-int", keys, probes, 1);
+	compareNodeStorage<BTree<int, std::string>>("int-string", keys, probes, std::string("value"));
+}
+
+template <typename Tree, typename Key, typename Value>
+void reportSizeClasses(const char *label, const std::vector<Key> &keys, const Value &value) {
+	Tree tree;
+
+	for (const Key &key : keys)
+	{
+		tree.insert(key, value);
+	}
+
+	auto stats = tree.poolStats();
+
+	// what every slot cost while both kinds shared one union-sized slot
+	const size_t unionBytes = stats.liveNodes * std::max(Tree::s_LEAF_NODE_BYTES, Tree::s_INTERNAL_NODE_BYTES);
+
+	std::cout << label << "\tleaf-node-bytes: " << Tree::s_LEAF_NODE_BYTES
+		<< "\tinternal-node-bytes: " << Tree::s_INTERNAL_NODE_BYTES
+		<< "\tnodes: " << stats.liveNodes
+		<< "\tlive-bytes: " << stats.liveBytes
+		<< "\tunion-bytes: " << unionBytes << std::endl;
+}
+
+void sizeClassTests() {
+	std::cout << "=========== sizeClassTests ===========" << std::endl;
+
+	const int insertions = 1e6;
+
+	std::mt19937 generate(21);
+	std::vector<int> keys(insertions);
+	std::vector<std::string> stringKeys(insertions);
+
+	for (int i = 0; i < insertions; ++i)
+	{
+		keys[i] = static_cast<int>(generate());
+		stringKeys[i] = std::to_string(keys[i]);
+	}
+
+	reportSizeClasses<BTree<int, int>>("int-int", keys, 1);
+	reportSizeClasses<BTree<int, std::string>>("int-string", keys, std::string("value"));
+	reportSizeClasses<BTree<std::string, int>>("string-int", stringKeys, 1);
+	reportSizeClasses<BTree<int, int, std::less<int>, BTreeDefaultLeafCapacity<int, int>,
+		BTreeDefaultInternalCapacity<int>, CompactHandleTraits>>("int-int-handles", keys, 1);
+}
+
+void sequentialInsertTests() {
+	std::cout << "=========== sequentialInsertTests ===========" << std::endl;
+
+	const int count = 2e6;
+
+	std::vector<int> keys(count);
+
+	for (int i = 0; i < count; ++i)
+	{
+		keys[i] = i;
+	}
+
+	BTree<int, int> sequential;
+
+	auto t0_sequential = std::chrono::steady_clock::now();
+
+	for (int key : keys)
+	{
+		sequential.insert(key, key);
+	}
+
+	auto t1_sequential = std::chrono::steady_clock::now();
+
+	unsigned seed = std::chrono::system_clock::now().time_since_epoch().count();
+	std::shuffle(keys.begin(), keys.end(), std::mt19937(seed));
+
+	BTree<int, int> shuffled;
+
+	auto t0_shuffled = std::chrono::steady_clock::now();
+
+	for (int key : keys)
+	{
+		shuffled.insert(key, key);
+	}
+
+	auto t1_shuffled = std::chrono::steady_clock::now();
+
+	auto duration_sequential = std::chrono::duration_cast<std::chrono::milliseconds>(t1_sequential - t0_sequential).count();
+	auto duration_shuffled = std::chrono::duration_cast<std::chrono::milliseconds>(t1_shuffled - t0_shuffled).count();
+
+	std::cout << "sequential-insert-time: " << duration_sequential << "\tnodes: " << sequential.poolStats().liveNodes << std::endl;
+	std::cout << "shuffled-insert-time: " << duration_shuffled << "\tnodes: " << shuffled.poolStats().liveNodes << std::endl;
+
+	// the appends left the right spine underfull; removals and middle inserts must still rebalance
+	std::vector<char> present(count, 1);
+	std::mt19937 generate(seed);
+
+	for (int key = count - 1; key > count - 20000; key -= 3)
+	{
+		sequential.remove(key);
+		present[key] = 0;
+	}
+
+	for (int i = 0; i < count / 4; ++i)
+	{
+		int key = generate() % count;
+
+		sequential.remove(key);
+		present[key] = 0;
+	}
+
+	for (int key = 1; key < count; key += 997)
+	{
+		sequential.insert(key, key);
+		present[key] = 1;
+	}
+
+	int expected = 0;
+	bool ordered = true;
+
+	for (auto [key, value] : sequential)
+	{
+		while (expected < count && !present[expected])
+		{
+			++expected;
+		}
+
+		ordered = ordered && key == expected && value == expected;
+		++expected;
+	}
+
+	while (expected < count && !present[expected])
+	{
+		++expected;
+	}
+
+	check(sequential.size() == static_cast<size_t>(std::count(present.begin(), present.end(), 1)), "appended tree keeps its size through removals");
+	check(ordered && expected == count, "appended tree keeps its keys through removals");
+}
+
+template <typename Tree>
+void underflowPolicyRun(const char* label, const std::vector<int>& inserts, const std::vector<int>& removes)
+{
+	Tree tree;
+
+	for (int key : inserts)
+	{
+		tree.insert(key, "1");
+	}
+
+	size_t removed = 0;
+
+	auto t0 = std::chrono::steady_clock::now();
+
+	for (int key : removes)
+	{
+		if (tree.remove(key))
+			removed++;
+	}
+
+	auto t1 = std::chrono::steady_clock::now();
+
+	auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(t1 - t0).count();
+
+	std::cout << label << "-remove-time: " << duration << "\tremoved: " << removed
+		<< "\tsize: " << tree.size() << "\tnodes: " << tree.poolStats().liveNodes << std::endl;
+}
+
+void underflowPolicyTests() {
+	std::cout << "=========== underflowPolicyTests ===========" << std::endl;
+
+	const int count = 1e6;
+
+	unsigned seed = std::chrono::system_clock::now().time_since_epoch().count();
+	std::mt19937 generate(seed);
+
+	std::vector<int> inserts(count);
+	std::vector<int> removes;
+
+	for (int i = 0; i < count; ++i)
+	{
+		inserts[i] = static_cast<int>(generate());
+	}
+
+	// three quarters of the keys plus as many absent ones
+	removes.reserve(count * 3 / 2);
+
+	for (int i = 0; i < count * 3 / 4; ++i)
+	{
+		removes.push_back(inserts[i]);
+		removes.push_back(static_cast<int>(generate()));
+	}
+
+	std::shuffle(removes.begin(), removes.end(), generate);
+
+	using Tree = BTree<int, std::string>;
+	using LazyTree = BTree<int, std::string, std::less<int>,
+		BTreeDefaultLeafCapacity<int, std::string>,
+		BTreeDefaultInternalCapacity<int>,
+		MergeWhenEmptyTraits>;
+
+	underflowPolicyRun<Tree>("rebalance", inserts, removes);
+	underflowPolicyRun<LazyTree>("merge-when-empty", inserts, removes);
+}
+
+void insertBatchTests() {
+	std::cout << "=========== insertBatchTests ===========" << std::endl;
+
+	const int initial = 1e6;
+	const int batches = 10;
+	const int batchSize = 5e4;
+
+	unsigned seed = std::chrono::system_clock::now().time_since_epoch().count();
+	std::mt19937 generate(seed);
+
+	std::vector<std::pair<int, std::string>> sorted;
+
+	sorted.reserve(initial);
+
+	for (int i = 0; i < initial; ++i)
+	{
+		sorted.emplace_back(static_cast<int>(generate()), "1");
+	}
+
+	std::sort(sorted.begin(), sorted.end(), [](auto const &a, auto const &b) { return a.first < b.first; });
+
+	std::vector<std::vector<std::pair<int, std::string>>> writes(batches);
+
+	for (auto &batch : writes)
+	{
+		batch.reserve(batchSize);
+
+		for (int i = 0; i < batchSize; ++i)
+		{
+			batch.emplace_back(static_cast<int>(generate()), "2");
+		}
+	}
+
+	BTree<int, std::string> perKey(sorted.begin(), sorted.end(), 0.75);
+	BTree<int, std::string> batched(sorted.begin(), sorted.end(), 0.75);
+	size_t insertedPerKey = 0;
+	size_t insertedBatched = 0;
+
+	auto t0_perKey = std::chrono::steady_clock::now();
+
+	for (auto const &batch : writes)
+	{
+		for (auto const &[key, value] : batch)
+		{
+			if (perKey.insert(key, value))
+				insertedPerKey++;
+		}
+	}
+
+	auto t1_perKey = std::chrono::steady_clock::now();
+
+	for (auto const &batch : writes)
+	{
+		insertedBatched += batched.insertBatch(batch);
+	}
+
+	auto t1_batched = std::chrono::steady_clock::now();
+
+	auto duration_perKey = std::chrono::duration_cast<std::chrono::milliseconds>(t1_perKey - t0_perKey).count();
+	auto duration_batched = std::chrono::duration_cast<std::chrono::milliseconds>(t1_batched - t1_perKey).count();
+
+	std::cout << "per-key-insert-time: " << duration_perKey << "\tinserted: " << insertedPerKey << "\tsize: " << perKey.size() << std::endl;
+	std::cout << "insert-batch-time: " << duration_batched << "\tinserted: " << insertedBatched << "\tsize: " << batched.size() << std::endl;
+
+	std::map<int, std::string> reference(sorted.begin(), sorted.end());
+
+	for (auto const &batch : writes)
+	{
+		for (auto const &[key, value] : batch)
+		{
+			reference[key] = value;
+		}
+	}
+
+	check(insertedBatched == insertedPerKey, "insertBatch reports the same new keys as per-key inserts");
+	check(batched.size() == reference.size() && perKey.size() == reference.size(), "both trees hold every distinct key");
+	check(std::equal(batched.begin(), batched.end(), reference.begin(), reference.end(),
+		[](auto const &entry, auto const &expected) { return entry.first == expected.first && entry.second == expected.second; }),
+		"insertBatch matches the reference map");
+	check(std::ranges::equal(perKey, batched), "per-key inserts match insertBatch");
+}
+
+void nodeChurnTests() {
+	std::cout << "=========== nodeChurnTests ===========" << std::endl;
+
+	const int keyspace = 2e5;
+	const int rounds = 10;
+
+	std::vector<int> keys(keyspace);
+
+	for (int i = 0; i < keyspace; ++i)
+	{
+		keys[i] = i;
+	}
+
+	unsigned seed = std::chrono::system_clock::now().time_since_epoch().count();
+	std::mt19937 generate(seed);
+
+	BTree<int, std::string> tree;
+
+	for (int round = 0; round < rounds; ++round)
+	{
+		std::shuffle(keys.begin(), keys.end(), generate);
+
+		for (int key : keys)
+		{
+			tree.insert(key, "1");
+		}
+
+		std::shuffle(keys.begin(), keys.end(), generate);
+
+		for (int i = 0; i < keyspace; ++i)
+		{
+			if (generate() % 4 != 0)
+				tree.remove(keys[i]);
+		}
+
+		auto stats = tree.poolStats();
+
+		std::cout << "round: " << round << "\tsize: " << tree.size()
+			<< "\tlive: " << stats.liveNodes << "\tfree: " << stats.freeNodes
+			<< "\tused: " << stats.usedNodes << "\tblocks: " << stats.blocks << std::endl;
+	}
+
+	auto scan = [&tree]() {
+		size_t visited = 0;
+
+		for (auto const &entry : tree)
+		{
+			visited += entry.second.size();
+		}
+
+		return visited;
+	};
+
+	auto t0_scan = std::chrono::steady_clock::now();
+	size_t visitedBefore = scan();
+	auto t1_scan = std::chrono::steady_clock::now();
+
+	while (!tree.compact(1024))
+	{
+	}
+
+	auto t1_compact = std::chrono::steady_clock::now();
+	size_t visitedAfter = scan();
+	auto t2_scan = std::chrono::steady_clock::now();
+
+	auto stats = tree.poolStats();
+
+	std::cout << "scan-before-compact: " << std::chrono::duration_cast<std::chrono::microseconds>(t1_scan - t0_scan).count()
+		<< "us\tvisited: " << visitedBefore << std::endl;
+	std::cout << "compact-time: " << std::chrono::duration_cast<std::chrono::microseconds>(t1_compact - t1_scan).count()
+		<< "us\tlive: " << stats.liveNodes << "\tused: " << stats.usedNodes << "\tblocks: " << stats.blocks << std::endl;
+	std::cout << "scan-after-compact: " << std::chrono::duration_cast<std::chrono::microseconds>(t2_scan - t1_compact).count()
+		<< "us\tvisited: " << visitedAfter << std::endl;
+}
+
+template <typename Key, typename Value, size_t LeafCapacity, size_t InternalCapacity>
+void capacitySweepRun(const std::vector<Key>& keys, const Value& value)
+{
+	BTree<Key, Value, std::less<Key>, LeafCapacity, InternalCapacity> tree;
+	size_t found = 0;
+
+	auto t0_insert = std::chrono::steady_clock::now();
+
+	for (const Key& key : keys)
+	{
+		tree.insert(key, value);
+	}
+
+	auto t1_insert = std::chrono::steady_clock::now();
+
+	for (const Key& key : keys)
+	{
+		if (tree.search(key))
+			found++;
+	}
+
+	auto t1_search = std::chrono::steady_clock::now();
+
+	auto duration_insert = std::chrono::duration_cast<std::chrono::milliseconds>(t1_insert - t0_insert).count();
+	auto duration_search = std::chrono::duration_cast<std::chrono::milliseconds>(t1_search - t1_insert).count();
+
+	std::cout << "leaf: " << LeafCapacity << "\tinternal: " << InternalCapacity
+		<< "\tinsert-time: " << duration_insert
+		<< "\tsearch-time: " << duration_search
+		<< "\tfound: " << found << std::endl;
+}
+
+/**
+ * Sweeps the leaf capacity with the internal capacity fixed at its default, then the
+ * internal capacity with the leaf capacity fixed at its default.
+ */
+template <typename Key, typename Value, size_t... Capacities>
+void capacitySweep(const char* label, const std::vector<Key>& keys, const Value& value)
+{
+	constexpr size_t defaultLeaf = BTreeDefaultLeafCapacity<Key, Value>;
+	constexpr size_t defaultInternal = BTreeDefaultInternalCapacity<Key>;
+
+	std::cout << "=========== capacitySweep " << label << " (default leaf: " << defaultLeaf
+		<< ", default internal: " << defaultInternal << ") ===========" << std::endl;
+
+	(capacitySweepRun<Key, Value, Capacities, defaultInternal>(keys, value), ...);
+	(capacitySweepRun<Key, Value, defaultLeaf, Capacities>(keys, value), ...);
+}
+
+void capacitySweepTests() {
+	const int insertions = 2e5;
+
+	unsigned seed = std::chrono::system_clock::now().time_since_epoch().count();
+	std::mt19937 generate(seed);
+
+	std::vector<int> intKeys;
+	std::vector<std::string> stringKeys;
+
+	intKeys.reserve(insertions);
+	stringKeys.reserve(insertions);
+
+	for (int i = 0; i < insertions; ++i)
+	{
+		int key = generate();
+
+		intKeys.push_back(key);
+		stringKeys.push_back("tenant/" + std::to_string(key % 1000) + "/item/" + std::to_string(key));
+	}
+
+	capacitySweep<int, std::string, 8, 16, 32, 64, 128, 255>("int -> std::string", intKeys, std::string("1"));
+	capacitySweep<int, int, 8, 16, 32, 64, 128, 255>("int -> int", intKeys, 1);
+	capacitySweep<std::string, int, 8, 16, 32, 64, 128, 255>("std::string -> int", stringKeys, 1);
+}
+
+int main() {
+	auto tree = std::make_unique<BTree<int, std::string>>();
+
+	std::cout << "=========== standardTests (array of pairs leaves) ===========" << std::endl;
+
+	standardTests(*tree);
+
+	std::cout << "=========== standardTests (split keys/values leaves) ===========" << std::endl;
+
+	auto splitTree = std::make_unique<SplitLeafTree>();
+
+	standardTests(*splitTree);
+
+	orderedMapTests();
+
+	bulkLoadTests();
+
+	sequentialInsertTests();
+
+	rangeViewTests();
+
+	orderStatisticsTests();
+
+	aggregateTests();
+
+	eraseRangeTests();
+
+	splitJoinTests();
+
+	mergeFromTests();
+
+	setOperatorTests();
+
+	truncatedSeparatorTests();
+
+	prefixLeafTests();
+
+	abbreviatedKeyTests();
+
+	nodeHandleTests();
+
+	nodeStorageTests();
+
+	sizeClassTests();
+
+	insertBatchTests();
+
+	underflowPolicyTests();
+
+	nodeChurnTests();
+
+	capacitySweepTests();
 
 	// jsonSerializationTests(*tree);
 
-	return 0;
+	return failures == 0 ? 0 : 1;
 }